@@ -49,6 +49,7 @@ enum Keys {
 	KRamFirmBoot,
 
 	KSplashDuration,
+	KFirmCache,
 
 	/*
 	KBootOption1NandImage,
@@ -86,3 +87,4 @@ void configRestoreDefaults();
 bool configDeleteKey(int key);
 bool configDevModeEnabled();
 bool configRamFirmBootEnabled();
+bool configFirmCacheEnabled();
@@ -23,4 +23,6 @@
 
 
 s32 loadVerifyFirm(const char *const path, bool skipHashCheck);
+s32 prefetchFirm(const char *const path);
+s32 enableFirmCache(bool enable);
 noreturn void firmLaunch(void);
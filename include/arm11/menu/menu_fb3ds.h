@@ -22,6 +22,7 @@
 #include "arm11/menu/bootslot.h"
 #include "arm11/menu/menu.h"
 #include "arm11/menu/menu_func.h"
+#include "fs.h"
 
 #define SUBENTRY_SLOT_BOOT(x) \
 	{ "Boot [slot " #x "]",				DESC_BOOT_SLOT(x),			&menuLaunchFirm,		(x-1) }
@@ -62,6 +63,7 @@
 #define DESC_BOOT_QUIET		"In quiet boot mode, splash is not displayed and the boot is continued via the first available autoboot slot.\n \n! To enter the menu, hold the HOME button at boot !"
 #define DESC_CHANGE_BOOT	"Change fastboot3ds boot mode. This allows you to set up how your console boots."
 #define DESC_FCRAM_BOOT		"Enable booting firm from FCRAM. This is required for proper A9NC and A9SP support, don't enable this if you use neither."
+#define DESC_FIRM_CACHE		"Keep the last booted firm in FCRAM. Rebooting into the same boot slot skips loading it from storage if the file didn't change."
 
 #define DESC_SPLASH_CUSTOM	"Select a custom splash. This is compatible with Luma 3DS format splash screens."
 #define DESC_SPLASH_DEFAULT	"Use default fastboot3DS splash screen."
@@ -72,11 +74,15 @@
 #define DESC_NAND_RESTORE	"Restore current NAND from a file.\nThis option preserves your fastboot3ds installation."
 #define DESC_NAND_RESTORE_F	"Restore current NAND from a file.\nWARNING: This will overwrite all of your flash memory, also overwriting fastboot3ds."
 #define DESC_FIRM_FLASH		"Flash firmware from file to firm1:.\nWARNING: This will allow you to flash unsigned firmware, overwriting anything previously installed in firm1:."
+#define DESC_DISCARD_NAND	"Discard the free space of the CTRNAND partition. Firmware partitions and protected areas are not touched."
 #define DESC_DUMP_BOOTROM	"Dump boot9.bin, boot11.bin & otp.bin.\nFiles are written to sdmc:/3DS. Your console will power off when finished."
 
 #define DESC_UPDATE			"Update fastboot3ds. Only signed updates are allowed."
 #define DESC_MOVE_CONFIG	"Change location of the config file."
+#define DESC_DISCARD_SD		"Discard the free space of the SD card. This may speed up later writes, like NAND backups, on well-used cards.\nDeleted files can't be recovered afterwards."
 #define DESC_CREDITS    	"Show fastboot3ds credits."
+#define DESC_DEBUG			"Enter debug submenu. Only available in debug builds."
+#define DESC_CRYPTO_BENCH	"Measure AES/SHA engine throughput for sizes from 16 bytes to 4 MiB.\nResults are written to sdmc:/3ds/fb3ds_bench.csv."
 
 // unused definitions below:
 #define LOREM "Lorem ipsum dolor sit amet, consetetur sadipscing elitr, sed diam nonumy eirmod tempor invidunt ut labore et dolore magna aliquyam erat, sed diam voluptua. At vero eos et accusam et justo duo dolores et ea rebum. Stet clita kasd gubergren, no sea takimata"
@@ -91,7 +97,11 @@
 MenuInfo menu_fb3ds[] =
 {
 	{
+#ifdef NDEBUG
 		"Main Menu", 6, NULL, 0, 
+#else
+		"Main Menu", 7, NULL, 0, 
+#endif
 		{
 			{ "Continue boot",				DESC_CONTINUE,				&menuReturn,			MENU_RET_CONTINUE },
 			{ "Boot menu...",				DESC_BOOT_MENU,				NULL,					1 },
@@ -99,7 +109,7 @@ MenuInfo menu_fb3ds[] =
 			{ "Boot from file...",			DESC_BOOT_FILE,				&menuLaunchFirm,		0xFF },
 			{ "NAND tools...",				DESC_NAND_TOOLS,			NULL,					5 },
 			{ "Miscellaneous...",			DESC_MISC,	    			NULL,					6 },
-			// { "Debug...",					LOREM,	    				NULL,					13 }
+			{ "Debug...",					DESC_DEBUG,	    			NULL,					13 }
 		}
 	},
 	{ // 1
@@ -114,7 +124,7 @@ MenuInfo menu_fb3ds[] =
 		}
 	},
 	{ // 2
-		"Boot Setup", N_BOOTSLOTS + 3, &menuPresetBootConfig, MENU_FLAG_SLOTS | MENU_FLAG_BOOTMODE | MENU_FLAG_CONFIG,
+		"Boot Setup", N_BOOTSLOTS + 4, &menuPresetBootConfig, MENU_FLAG_SLOTS | MENU_FLAG_BOOTMODE | MENU_FLAG_CONFIG,
 		{
 			SUBENTRY_SLOT_SETUP(1),
 			SUBENTRY_SLOT_SETUP(2),
@@ -124,7 +134,8 @@ MenuInfo menu_fb3ds[] =
 			SUBENTRY_SLOT_SETUP(6),
 			{ "Change boot mode...",		DESC_CHANGE_BOOT,			NULL,					3 },
 			{ "Change splash...",			DESC_CHANGE_SPLASH,			NULL,					4 },
-			{ "Enable FCRAM Boot",			DESC_FCRAM_BOOT,			&menuSwitchFcramBoot,	0 }
+			{ "Enable FCRAM Boot",			DESC_FCRAM_BOOT,			&menuSwitchFcramBoot,	0 },
+			{ "Enable FIRM cache",			DESC_FIRM_CACHE,			&menuSwitchFirmCache,	0 }
 		}
 	},
 	{ // 3
@@ -144,20 +155,22 @@ MenuInfo menu_fb3ds[] =
 		}
 	},
 	{ // 5
-		"NAND Tools", 4, &menuPresetNandTools, 0,
+		"NAND Tools", 5, &menuPresetNandTools, 0,
 		{
 			{ "Backup NAND",				DESC_NAND_BACKUP,			&menuBackupNand,		0 },
 			{ "Restore NAND",				DESC_NAND_RESTORE,			&menuRestoreNand,		0 },
 			{ "Restore NAND (forced)",		DESC_NAND_RESTORE_F,		&menuRestoreNand,		1 },
-			{ "Flash firmware to FIRM1",	DESC_FIRM_FLASH,			&menuInstallFirm,		1 }
+			{ "Flash firmware to FIRM1",	DESC_FIRM_FLASH,			&menuInstallFirm,		1 },
+			{ "Discard NAND free space",	DESC_DISCARD_NAND,			&menuDiscardFreeSpace,	FS_DRIVE_NAND }
 		}
 	},
 	{ // 6
-		"Miscellaneous", 4, NULL, 0,
+		"Miscellaneous", 5, NULL, 0,
 		{
 			{ "Update fastboot3DS",			DESC_UPDATE,				&menuUpdateFastboot3ds,	0 },
 			{ "Dump bootroms & OTP",		DESC_DUMP_BOOTROM,			&menuDumpBootrom,		0 },
 			{ "Change config location",		DESC_MOVE_CONFIG,			&menuMoveConfig,		0 },
+			{ "Discard SD free space",		DESC_DISCARD_SD,			&menuDiscardFreeSpace,	FS_DRIVE_SDMC },
 			{ "Credits",					DESC_CREDITS,				&menuShowCredits,		0 }
 		}
 	},
@@ -167,11 +180,12 @@ MenuInfo menu_fb3ds[] =
 	SUBMENU_SLOT_SETUP(4), // 10
 	SUBMENU_SLOT_SETUP(5), // 11
 	SUBMENU_SLOT_SETUP(6), // 12
-	/*{ // 13
-		"Debug", 2, NULL, 0, // this will not show in the release version
+	{ // 13
+		"Debug", 1, NULL, 0, // this will not show in the release version
 		{
-			{ "View current settings",		LOREM,						&debugSettingsView,		0 },
-			{ "Escape sequence test",		LOREM,						&debugEscapeTest,		0 } 
+			{ "Crypto benchmark",			DESC_CRYPTO_BENCH,			&menuCryptoBenchmark,	0 },
+			// { "View current settings",		LOREM,						&debugSettingsView,		0 },
+			// { "Escape sequence test",		LOREM,						&debugEscapeTest,		0 } 
 		}
-	}*/
+	}
 };
@@ -20,12 +20,13 @@
 
 #include "types.h"
 #include "mem_map.h"
+#include "fs.h"
 #include "arm11/hardware/cfg11.h"
 #include "arm11/console.h"
 
 
 #define NAND_BACKUP_PATH	"sdmc:/3DS" // NAND backups standard path
-#define DEVICE_BUFSIZE		(((REG_CFG11_SOCINFO & 2) ? 1024 : 512) * 1024) // 1024 / 512 KiB
+#define DEVICE_BUFSIZE		((REG_CFG11_SOCINFO & 2) ? FS_DEVBUF_SIZE_N3DS : FS_DEVBUF_SIZE_O3DS)
 #define PROGRESS_WIDTH		20
 #define SPLASH_DEFAULT_MSEC	1000
 #define SPLASH_MIN_MSEC		500
@@ -54,6 +55,7 @@ u32 menuSetBootMode(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuSetSplash(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuSetSplashDuration(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuSwitchFcramBoot(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
+u32 menuSwitchFirmCache(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuSetupBootSlot(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuSetupBootKeys(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuLaunchFirm(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
@@ -64,6 +66,8 @@ u32 menuUpdateFastboot3ds(PrintConsole* term_con, PrintConsole* menu_con, u32 pa
 u32 menuShowCredits(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuDumpBootrom(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuMoveConfig(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
+u32 menuDiscardFreeSpace(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
+u32 menuCryptoBenchmark(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 
 // everything below has to go
 u32 menuDummyFunc(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
@@ -32,6 +32,7 @@ typedef struct
 	bool (*close)();
 	bool (*is_active)();
 	u32  (*get_sector_count)();
+	bool (*trim_sector)(u32 sector, u32 count); // Optional
 } dev_struct;
 
 extern const dev_struct *dev_sdcard;
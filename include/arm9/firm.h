@@ -49,4 +49,10 @@ typedef struct
 
 bool firm_size(size_t *size, const firm_header *const hdr);
 s32 loadVerifyFirm(const char *const path, bool skipHashCheck, bool installMode);
+// Like loadVerifyFirm() in install mode but also outputs the SHA 256 hash
+// of the signed header part for RSA_verify2048Hash().
+s32 loadVerifyFirmHashHeader(const char *const path, u32 hdrHash[8]);
+s32 prefetchFirm(const char *const path);
+void invalidatePrefetchedFirm(void);
+s32 enableFirmCache(bool enable);
 noreturn void firmLaunch(void);
@@ -98,6 +98,7 @@ void AES_setKey(u8 keyslot, AesKeyType type, u8 orderEndianess, bool twlScramble
 
 /**
  * @brief      Selects the given keyslot for all following crypto operations.
+ * @brief      Does nothing if the keyslot is already selected.
  *
  * @param[in]  keyslot  The keyslot to select.
  */
@@ -150,9 +151,34 @@ void AES_setCryptParams(AES_ctx *const ctx, u8 inEndianessOrder, u8 outEndianess
 void AES_ctr(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool dma);
 
 /**
- * @brief      En-/decrypts data with AES CBC.
- * @brief      Note: With DMA the output buffer must be invalidated
- * @brief      after this function, not before.
+ * @brief      Starts an AES CTR operation with one side connected to a peripheral
+ * @brief      FIFO instead of memory. The peripheral paces the transfer so
+ * @brief      the data never passes through RAM. Uses NDMA channels 0 and 1.
+ * @brief      Must be completed with AES_ctrFifoFinish().
+ *
+ * @param      ctx       Pointer to AES_ctx (AES context).
+ * @param[in]  fifo      Address of the peripheral FIFO register.
+ * @param[in]  startup   NDMA startup mode of the peripheral FIFO.
+ * @param      buf       Memory side of the transfer. Must be word aligned
+ *                       and reachable by DMA.
+ * @param[in]  blocks    Number of blocks to process. Must be even and
+ *                       no more than AES_MAX_BLOCKS.
+ * @param[in]  fromFifo  true = fifo -> AES -> buf. false = buf -> AES -> fifo.
+ */
+void AES_ctrFifoStart(AES_ctx *const ctx, u32 fifo, u32 startup, u32 *buf, u32 blocks, bool fromFifo);
+
+/**
+ * @brief      Waits for an AES operation started with AES_ctrFifoStart() to finish.
+ *
+ * @param[in]  abort  Set to true to stop the transfer (peripheral error).
+ */
+void AES_ctrFifoFinish(bool abort);
+
+/**
+ * @brief      En-/decrypts data with AES CBC. The IV in ctx (AES_setCtrIv())
+ * @brief      is updated so the next call continues the chain.
+ * @brief      Note: With DMA the output buffer must be flushed/invalidated
+ * @brief      before this function like for all other modes.
  *
  * @param      ctx     Pointer to AES_ctx (AES context).
  * @param[in]  in      In data pointer. Can be the same as out.
@@ -161,7 +187,20 @@ void AES_ctr(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool dma);
  * @param[in]  enc     Set to true to encrypt and false to decrypt.
  * @param[in]  dma     Set to true to enable DMA.
  */
-//void AES_cbc(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool enc, bool dma);
+void AES_cbc(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool enc, bool dma);
+
+/**
+ * @brief      Calculates the AES CBC-MAC over the data. The IV in ctx is
+ * @brief      updated so the MAC can be calculated in multiple calls.
+ * @brief      Note: Plain CBC-MAC is only secure for fixed length messages.
+ *
+ * @param      ctx     Pointer to AES_ctx (AES context).
+ * @param[in]  in      In data pointer.
+ * @param[in]  blocks  Number of blocks to process. 1 block is 16 bytes.
+ * @param      mac     The MAC (last ciphertext block) in output word order.
+ * @param[in]  dma     Set to true to enable DMA.
+ */
+void AES_cbcMac(AES_ctx *const ctx, const u32 *in, u32 blocks, u32 mac[4], bool dma);
 
 /**
  * @brief      En-/decrypts data with AES ECB.
@@ -228,6 +267,21 @@ void SHA_start(u8 params);
  */
 void SHA_update(const u32 *data, u32 size);
 
+/**
+ * @brief      Starts hashing the data pointed to with NDMA channel 2 and
+ * @brief      returns immediately. Wait with SHA_waitDma() before using
+ * @brief      the SHA engine again.
+ *
+ * @param[in]  data  Pointer to data to hash. Must be reachable by DMA.
+ * @param[in]  size  Size of the data to hash. Must be a multiple of 64.
+ */
+void SHA_updateDmaAsync(const u32 *data, u32 size);
+
+/**
+ * @brief      Waits until a SHA_updateDmaAsync() transfer finished.
+ */
+void SHA_waitDma(void);
+
 /**
  * @brief      Generates the final hash.
  *
@@ -336,3 +390,14 @@ bool RSA_decrypt2048(u32 *const decSig, const u32 *const encSig);
  * @return     Returns true if the signature is valid, false otherwise.
  */
 bool RSA_verify2048(const u32 *const encSig, const u32 *const data, u32 size);
+
+/**
+ * @brief      Verifies a RSA 2048 SHA 256 signature against an already calculated hash.
+ * @brief      Note: This function skips the ASN.1 data and is therefore not safe.
+ *
+ * @param[in]  encSig  Pointer to encrypted source signature.
+ * @param[in]  hash    The big endian SHA 256 hash of the signed data.
+ *
+ * @return     Returns true if the signature is valid, false otherwise.
+ */
+bool RSA_verify2048Hash(const u32 *const encSig, const u32 hash[8]);
@@ -119,6 +119,8 @@ extern "C" {
 		u32 devicenumber;
 		u32 total_size; //size in sectors of the device
 		u32 res;
+		u32 dma; // FIFO is handled by an NDMA channel set up by the caller
+		u32 canTrim; // eMMC 4.4+ TRIM support from EXT_CSD
 	} mmcdevice;
 
 	void sdmmc_init();
@@ -129,6 +131,13 @@ extern "C" {
 
 	int sdmmc_nand_readsectors(u32 sector_no, u32 numsectors, u8 *out);
 	int sdmmc_nand_writesectors(u32 sector_no, u32 numsectors, const u8 *in);
+	// Same as above but REG_SDFIFO32 must be serviced by an NDMA channel
+	// with NDMA_STARTUP_MMC1 which the caller has set up beforehand.
+	int sdmmc_nand_readsectors_dma(u32 sector_no, u32 numsectors);
+	int sdmmc_nand_writesectors_dma(u32 sector_no, u32 numsectors);
+	// Discard the contents of the given sectors. Unused sectors read back as 0s or 1s.
+	int sdmmc_sdcard_erasesectors(u32 sector_no, u32 numsectors);
+	int sdmmc_nand_trimsectors(u32 sector_no, u32 numsectors);
 
 	int sdmmc_get_cid(bool isNand, u32 *info);
 
@@ -86,6 +86,24 @@ u16 TIMER_getTicks(Timer timer);
  */
 u16 TIMER_stop(Timer timer);
 
+/**
+ * @brief      Starts timer 0 and 1 cascaded as free running 32 bit counter
+ *             at TIMER_BASE_FREQ. Overflows after ~64 seconds.
+ */
+void TIMER_startCounter32(void);
+
+/**
+ * @brief      Returns the current value of the 32 bit counter.
+ *
+ * @return     The number of ticks since TIMER_startCounter32().
+ */
+u32 TIMER_getCounter32(void);
+
+/**
+ * @brief      Stops the 32 bit counter.
+ */
+void TIMER_stopCounter32(void);
+
 /**
  * @brief      Halts the CPU for the specified number of milliseconds.
  *
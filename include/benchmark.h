@@ -0,0 +1,157 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+
+
+#define BENCH_MIN_SIZE        (16u)
+#define BENCH_MAX_SIZE        (0x400000u)
+#define BENCH_NUM_SIZES       (19u)           // 16 B to 4 MiB in powers of 2
+#define BENCH_MIN_BYTES       (0x100000u)     // Each size is repeated until this much was processed
+
+// Timer frequencies the ticks in BenchResult are based on
+#define BENCH_ARM9_TICK_FREQ  (67027964u)     // ARM9 timers, half the ARM9 clock
+#define BENCH_ARM11_TICK_FREQ (134055928u)    // MPCore timer, half the ARM11 clock (O3DS)
+
+#define LZSTUB_MAGIC          (0x5A4C3131u)   // "11LZ"
+
+// Boot stamps use the ARM11 cycle counter divided by 64 (O3DS)
+#define BOOT_STAMP_FREQ       (268111856u / 64)
+
+
+typedef enum
+{
+	// ARM9
+	BENCH_AES_CTR_CPU   = 0u,
+	BENCH_AES_CTR_DMA32 = 1u, // DMA with 32 bytes AES FIFO bursts
+	BENCH_AES_CTR_DMA16 = 2u, // DMA with 16 bytes AES FIFO bursts
+	BENCH_SHA1          = 3u,
+	BENCH_SHA224        = 4u,
+	BENCH_SHA256        = 5u,
+	BENCH_ARM9_TESTS    = 6u,
+
+	// ARM11
+	BENCH_HASH1         = 6u,
+	BENCH_HASH224       = 7u,
+	BENCH_HASH256       = 8u,
+	BENCH_NUM_TESTS     = 9u
+} BenchTest;
+
+typedef enum
+{
+	BOOT_STAMP_START  = 0u, // ARM11 main() entered
+	BOOT_STAMP_SPLASH = 1u, // First splash screen presented
+	BOOT_STAMP_LAUNCH = 2u, // FIRM launch about to start
+	BOOT_NUM_STAMPS   = 3u
+} BootStamp;
+
+typedef struct
+{
+	u8 test;    // BenchTest
+	u8 reserved[3];
+	u32 size;   // Bytes per call
+	u32 calls;  // 0 if the size is not supported by the test
+	u32 ticks;  // Total time for all calls
+} BenchResult;
+
+// Header of lzstub which unpacks the ARM11 binary at cold boot.
+// The LCD init clears it at A11_LZSTUB_ENTRY so the ARM11 saves a copy.
+typedef struct
+{
+	u32 branch;
+	u32 magic;      // LZSTUB_MAGIC
+	u32 cycles;     // ARM11 CPU cycles spent decompressing
+	u32 packedSize;
+	u32 size;
+	u32 done;
+} LzStubInfo;
+
+
+
+/**
+ * @brief      Runs all ARM9 crypto engine tests over all sizes.
+ *             Destroys the contents of the FIRM buffer.
+ *
+ * @param      results  Output array.
+ * @param[in]  num      Number of entries in results. Should be
+ *                      BENCH_ARM9_TESTS * BENCH_NUM_SIZES.
+ *
+ * @return     The number of results written or a negative error code.
+ */
+s32 benchmarkCrypto(BenchResult *const results, u32 num);
+
+/**
+ * @brief      Checks AES-CBC and AES-CBC-MAC against the NIST SP 800-38A
+ *             vectors with CPU and DMA transfers. Overwrites keyslot 0x11
+ *             and destroys the contents of the FIRM buffer.
+ *
+ * @return     0 on success or the negative number of the failed check.
+ */
+s32 selftestCrypto(void);
+
+#ifdef ARM11
+/**
+ * @brief      Runs all ARM11 HASH engine tests over all sizes.
+ *
+ * @param      results  Output array.
+ * @param[in]  num      Number of entries in results.
+ *
+ * @return     The number of results written or a negative error code.
+ */
+s32 benchmarkHash(BenchResult *const results, u32 num);
+
+/**
+ * @brief      Saves the lzstub header. Must be called before the LCDs
+ *             are initialized because that clears the VRAM.
+ */
+void benchmarkSaveLzStubInfo(void);
+
+/**
+ * @brief      Returns the lzstub header saved at boot.
+ */
+const LzStubInfo* benchmarkGetLzStubInfo(void);
+
+/**
+ * @brief      Records the time of a boot stage. Only the first call per
+ *             stamp counts. BOOT_STAMP_START (re)starts the cycle counter.
+ *
+ * @param[in]  stamp  The boot stage.
+ */
+void benchmarkBootStamp(BootStamp stamp);
+
+/**
+ * @brief      Returns the time from BOOT_STAMP_START to a boot stage.
+ *
+ * @param[in]  stamp  The boot stage.
+ * @param      us     Output for the time in microseconds.
+ *
+ * @return     false if the stamp was not recorded.
+ */
+bool benchmarkGetBootTime(BootStamp stamp, u32 *const us);
+
+/**
+ * @brief      Writes all recorded boot stamps as CSV file.
+ *
+ * @param[in]  path  The file path.
+ *
+ * @return     true on success.
+ */
+bool benchmarkWriteBootLog(const char *const path);
+#endif
@@ -25,8 +25,19 @@
 #define FS_MAX_DEVICES  (2)
 #define FS_MAX_DRIVES   (FF_VOLUMES)
 #define FS_DRIVE_NAMES  "sdmc:/","twln:/","twlp:/","nand:/"
-#define FS_MAX_FILES    (3)
-#define FS_MAX_DIRS     (2)
+#ifndef FS_MAX_FILES
+#define FS_MAX_FILES    (8)  // Max 0xFFFF
+#endif
+#ifndef FS_MAX_DIRS
+#define FS_MAX_DIRS     (4)  // Max 0xFFFF
+#endif
+#define FS_MAX_IOVECS   (32)
+// Largest device buffer on Old 3DS / New 3DS. NAND backups use all of it.
+#define FS_DEVBUF_SIZE_O3DS  (512 * 1024)
+#define FS_DEVBUF_SIZE_N3DS  (1024 * 1024)
+
+#define FS_ERR_NOT_CONTIGUOUS (-32)
+#define FS_ERR_UNSUPPORTED    (-33)
 
 
 typedef enum
@@ -58,6 +69,13 @@ typedef FILINFO FsFileInfo;
 typedef s32 DevHandle;
 typedef s32 DevBufHandle;
 
+typedef struct
+{
+	u32 offset;
+	u32 size;
+	void *buf; // Unused for device buffer transfers
+} FsIoVec;
+
 
 
 s32  fMount(FsDrive drive);
@@ -72,15 +90,19 @@ s32  fCreateDeviceBuffer(u32 size);
 s32  fFreeDeviceBuffer(DevBufHandle handle);
 s32  fReadToDeviceBuffer(s32 sourceHandle, u32 sourceOffset, u32 sourceSize, DevBufHandle devBufHandle);
 s32  fsWriteFromDeviceBuffer(s32 destHandle, u32 destOffset, u32 destSize, DevBufHandle devBufHandle);
+s32  fReadToDeviceBufferV(s32 sourceHandle, const FsIoVec *vec, u32 num, DevBufHandle devBufHandle);
+s32  fsWriteFromDeviceBufferV(s32 destHandle, const FsIoVec *vec, u32 num, DevBufHandle devBufHandle);
 s32  fOpen(const char *const path, FsOpenMode mode);
 s32  fRead(s32 handle, void *const buf, u32 size);
 s32  fWrite(s32 handle, const void *const buf, u32 size);
+s32  fReadV(s32 handle, const FsIoVec *vec, u32 num);
+s32  fWriteV(s32 handle, const FsIoVec *vec, u32 num);
 s32  fSync(s32 handle);
-s32  fLseek(s32 handle, u32 offset);
-u32  fTell(s32 handle);
-u32  fSize(s32 handle);
+s32  fLseek(s32 handle, u64 offset);
+u64  fTell(s32 handle);
+u64  fSize(s32 handle);
 s32  fClose(s32 handle);
-s32  fExpand(s32 handle, u32 size);
+s32  fExpand(s32 handle, u64 size);
 s32  fStat(const char *const path, FsFileInfo *fi);
 s32  fOpenDir(const char *const path);
 s32  fReadDir(s32 handle, FsFileInfo *fi, u32 num);
@@ -90,7 +112,22 @@ s32  fRename(const char *const old, const char *const new);
 s32  fUnlink(const char *const path);
 s32  fVerifyNandImage(const char *const path);
 s32  fSetNandProtection(bool protect);
+s32  fDiscardFreeSpace(FsDrive drive);
+
+#ifdef ARM11
+// Called with the path of a file or dir after its entry changed.
+// An empty path means the changed file is unknown.
+typedef void (*FsChangeCallback)(const char *path);
+
+void fSetChangeCallback(FsChangeCallback cb);
+#endif
 
 #ifdef ARM9
+s32  fMountLazy(FsDrive drive);
+s32  fOpenContiguous(const char *const path, FsOpenMode mode);
+u32  fGetStartCluster(s32 handle);
+bool fIsNandRangeProtected(u32 sector, u32 count);
+// Changes after every call that may have modified a file or partition
+u32  fGetModCount(void);
 void fsDeinit(void);
 #endif
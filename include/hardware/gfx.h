@@ -74,6 +74,12 @@ typedef enum
 
 void GFX_init(GfxFbFmt fmtTop, GfxFbFmt fmtBot);
 
+// Powers on the LCDs but leaves the backlights off. The screens stay black
+// until GFX_powerOnBacklights() is called.
+void GFX_initLcds(GfxFbFmt fmtTop, GfxFbFmt fmtBot);
+
+void GFX_powerOnBacklights(void);
+
 static inline void GFX_initDefault(void)
 {
 	GFX_init(GFX_BGR8, GFX_BGR8);
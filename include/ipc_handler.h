@@ -49,11 +49,11 @@ typedef enum
 	IPC_CMD9_FREAD               = MAKE_CMD(13, 0, 1, 1),
 	IPC_CMD9_FWRITE              = MAKE_CMD(14, 1, 0, 1),
 	IPC_CMD9_FSYNC               = MAKE_CMD(15, 0, 0, 1),
-	IPC_CMD9_FLSEEK              = MAKE_CMD(16, 0, 0, 2),
-	IPC_CMD9_FTELL               = MAKE_CMD(17, 0, 0, 1),
-	IPC_CMD9_FSIZE               = MAKE_CMD(18, 0, 0, 1),
+	IPC_CMD9_FLSEEK              = MAKE_CMD(16, 0, 0, 3),
+	IPC_CMD9_FTELL               = MAKE_CMD(17, 0, 1, 1),
+	IPC_CMD9_FSIZE               = MAKE_CMD(18, 0, 1, 1),
 	IPC_CMD9_FCLOSE              = MAKE_CMD(19, 0, 0, 1),
-	IPC_CMD9_FEXPAND             = MAKE_CMD(20, 0, 0, 2),
+	IPC_CMD9_FEXPAND             = MAKE_CMD(20, 0, 0, 3),
 	IPC_CMD9_FSTAT               = MAKE_CMD(21, 1, 1, 0),
 	IPC_CMD9_FOPEN_DIR           = MAKE_CMD(22, 1, 0, 0),
 	IPC_CMD9_FREAD_DIR           = MAKE_CMD(23, 0, 1, 2),
@@ -71,7 +71,17 @@ typedef enum
 	IPC_CMD9_TOGGLE_SUPERHAX     = MAKE_CMD(35, 0, 0, 1),
 	IPC_CMD9_PREPARE_POWER       = MAKE_CMD(36, 0, 0, 0),
 	IPC_CMD9_PANIC               = MAKE_CMD(37, 0, 0, 0),
-	IPC_CMD9_EXCEPTION           = MAKE_CMD(38, 0, 0, 0)
+	IPC_CMD9_EXCEPTION           = MAKE_CMD(38, 0, 0, 0),
+	IPC_CMD9_JOB_GET_STATUS      = MAKE_CMD(39, 0, 1, 1),
+	IPC_CMD9_FREADV              = MAKE_CMD(40, 1, 0, 1),
+	IPC_CMD9_FWRITEV             = MAKE_CMD(41, 1, 0, 1),
+	IPC_CMD9_FREADV_TO_DEV_BUF   = MAKE_CMD(42, 1, 0, 2),
+	IPC_CMD9_FWRITEV_FROM_DEV_BUF = MAKE_CMD(43, 1, 0, 2),
+	IPC_CMD9_PREFETCH_FIRM       = MAKE_CMD(44, 1, 0, 0),
+	IPC_CMD9_BENCHMARK_CRYPTO    = MAKE_CMD(45, 0, 1, 0),
+	IPC_CMD9_ENABLE_FIRM_CACHE   = MAKE_CMD(46, 0, 0, 1),
+	IPC_CMD9_FDISCARD_FREE       = MAKE_CMD(47, 0, 0, 1),
+	IPC_CMD9_SELFTEST_CRYPTO     = MAKE_CMD(48, 0, 0, 0)
 } IpcCmd9;
 
 typedef enum
@@ -0,0 +1,132 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+
+
+#define JOB_MAX_JOBS     (16)
+
+// Return this from a job function to get requeued at the end of its
+// priority queue. Long jobs should do their work in chunks this way
+// so higher priority jobs (IPC commands) don't get stalled.
+#define JOB_AGAIN        (-0x7FFFFFFF)
+
+#define JOB_ERR_NO_SLOT  (-1)
+#define JOB_ERR_INVALID  (-2)
+#define JOB_ERR_CANCELED (-3)
+
+
+typedef enum
+{
+	JOB_PRIO_PANIC  = 0u, // ARM11 panics. Runs before anything else.
+	JOB_PRIO_HIGH   = 1u, // IPC commands
+	JOB_PRIO_NORMAL = 2u,
+	JOB_PRIO_LOW    = 3u, // Background work like prefetching and hashing
+	JOB_PRIO_NUM    = 4u
+} JobPrio;
+
+typedef enum
+{
+	JOB_STATE_FREE    = 0u,
+	JOB_STATE_QUEUED  = 1u,
+	JOB_STATE_RUNNING = 2u,
+	JOB_STATE_DONE    = 3u
+} JobState;
+
+typedef struct
+{
+	u32 state;
+	s32 result;
+	u32 progress;
+	u32 total;
+} JobStatus;
+
+typedef s32 JobHandle;
+
+
+
+s32 JOB_getStatus(JobHandle handle, JobStatus *const status);
+
+#ifdef ARM9
+typedef s32 (*JobFunc)(void *arg);
+
+
+/**
+ * @brief      Queues a job. Can be called from IRQ context.
+ *
+ * @param[in]  prio      The priority.
+ * @param[in]  func      The job function.
+ * @param[in]  arg       The argument passed to func.
+ * @param[in]  autoFree  If true the slot is freed right after the job
+ *                       finished. The handle must not be used anymore.
+ *
+ * @return     The job handle or a negative error code.
+ */
+JobHandle JOB_post(JobPrio prio, JobFunc func, void *arg, bool autoFree);
+
+/**
+ * @brief      Runs the next job with the highest priority once.
+ *
+ * @return     Returns false if there was nothing to do.
+ */
+bool JOB_runNext(void);
+
+/**
+ * @brief      Waits for an interrupt if no job is queued.
+ */
+void JOB_idle(void);
+
+/**
+ * @brief      Runs the given job in place until it finished.
+ *             Must not be called for the job that is currently running.
+ *
+ * @param[in]  handle  The job handle.
+ *
+ * @return     The job result or a negative error code.
+ */
+s32 JOB_wait(JobHandle handle);
+
+/**
+ * @brief      Cancels a queued job. The job result will be JOB_ERR_CANCELED.
+ *             Jobs that already finished are not touched.
+ *
+ * @param[in]  handle  The job handle.
+ *
+ * @return     Returns true if the job was canceled.
+ */
+bool JOB_cancel(JobHandle handle);
+
+/**
+ * @brief      Frees the slot of a finished job.
+ *
+ * @param[in]  handle  The job handle.
+ *
+ * @return     The job result or a negative error code.
+ */
+s32 JOB_release(JobHandle handle);
+
+/**
+ * @brief      Updates the progress counters of the currently running job.
+ *
+ * @param[in]  progress  The amount of work done.
+ * @param[in]  total     The total amount of work.
+ */
+void JOB_setProgress(u32 progress, u32 total);
+#endif
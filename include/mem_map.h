@@ -119,6 +119,7 @@
 #define A9_VECTORS_SIZE      (0x40)
 #define A9_STUB_ENTRY        (ITCM_KERNEL_MIRROR + ITCM_SIZE - 0x200)
 #define A9_STUB_SIZE         (0x200)
+#define A9_IMAGE_MAX_SIZE    (0x00040000) // Checked in arm9.ld. The heap follows.
 #define A9_HEAP_END          (A9_RAM_BASE + A9_RAM_SIZE)
 #define A9_STACK_START       (DTCM_BASE)
 #define A9_STACK_END         (DTCM_BASE + DTCM_SIZE - 0x400)
@@ -128,6 +129,8 @@
 #define A9_EXC_STACK_END     (ITCM_KERNEL_MIRROR + ITCM_SIZE)
 #define FIRM_LOAD_ADDR       (VRAM_BASE + 0x200000)
 #define RAM_FIRM_BOOT_ADDR   (FCRAM_BASE + 0x1000)
+#define FIRM_CACHE_ADDR      (FCRAM_BASE + FCRAM_SIZE - FIRM_CACHE_SIZE)
+#define FIRM_CACHE_SIZE      (0x00400200) // Header + max FIRM size
 #endif
 
 
@@ -143,6 +146,7 @@
 #define A11_C3_STACK_END     (FCRAM_BASE - 0x200)
 #define A11_EXC_STACK_START  (VRAM_BASE + VRAM_SIZE - 0x200000)
 #define A11_EXC_STACK_END    (VRAM_BASE + VRAM_SIZE - 0x100000)
+#define A11_LZSTUB_ENTRY     (VRAM_BASE + 0x100000)        // Must match lzstub.ld and the Makefile
 #define A11_MMU_TABLES_BASE  (A11_C1_STACK_END)
 #define	A11_VECTORS_START    (AXIWRAM_BASE + AXIWRAM_SIZE - 0x60)
 #define A11_VECTORS_SIZE     (0x60)
@@ -0,0 +1,99 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+@ The bootrom loads this stub together with the LZ11 compressed ARM11
+@ binary to VRAM. It unpacks the binary to its link address and jumps
+@ to the real entrypoint.
+
+#include "mem_map.h"
+
+.arm
+.cpu mpcore
+.fpu vfpv2
+
+.global _start
+
+.type _start %function
+.type waitPayload %function
+
+.extern lz11Decompress
+
+.section ".crt0", "ax"
+
+
+
+_start:
+	b start2
+
+	@ Layout must match LzStubInfo in benchmark.h
+	.word 0x5A4C3131                @ Magic "11LZ"
+	cycles:     .word 0             @ CPU cycles spent decompressing
+	packedSize: .word payloadEnd - payload
+	size:       .word 0             @ Set from the LZ11 header
+	done:       .word 0
+
+start2:
+	cpsid aif
+	mrc p15, 0, r0, c0, c0, 5       @ Get CPU ID
+	ands r0, r0, #3
+	bne waitPayload
+
+	ldr sp, =A11_C0_STACK_END
+	mov r0, #5
+	mcr p15, 0, r0, c15, c12, 0     @ Reset and start the cycle counter
+
+	adr r0, payload
+	ldr r2, [r0], #4
+	lsr r2, r2, #8                  @ Decompressed size from the header
+	str r2, size
+	ldr r1, =PAYLOAD_ADDR
+	bl lz11Decompress
+
+	mrc p15, 0, r0, c15, c12, 1     @ Read cycle counter
+	str r0, cycles
+	mov r0, #0
+	mcr p15, 0, r0, c15, c12, 0     @ Stop the cycle counter
+
+	mcr p15, 0, r0, c7, c10, 0      @ Clean entire data cache
+	mcr p15, 0, r0, c7, c5, 0       @ Invalidate entire instruction cache
+	mcr p15, 0, r0, c7, c10, 4      @ Data Synchronization Barrier
+	mcr p15, 0, r0, c7, c5, 4       @ Flush Prefetch Buffer
+
+	mov r0, #1
+	str r0, done
+	sev
+	ldr pc, =PAYLOAD_ENTRY
+
+waitPayload:
+	@ Other cores wait for core 0 to finish
+	wfe
+	ldr r0, done
+	cmp r0, #0
+	beq waitPayload
+	mcr p15, 0, r0, c7, c5, 0       @ Invalidate entire instruction cache
+	ldr pc, =PAYLOAD_ENTRY
+
+.pool
+
+#include "../source/arm11/lz11.s"
+
+.section ".crt0", "ax"
+.align 2
+payload:
+	.incbin "payload.lz"
+payloadEnd:
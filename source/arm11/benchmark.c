@@ -0,0 +1,150 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "mem_map.h"
+#include "benchmark.h"
+#include "hardware/pxi.h"
+#include "ipc_handler.h"
+#include "arm11/hardware/hash.h"
+#include "arm11/hardware/performance_monitor.h"
+#include "arm11/hardware/timer.h"
+#include "arm11/fmt.h"
+#include "fsutils.h"
+
+
+
+static LzStubInfo lzStubInfo;
+static u32 bootStamps[BOOT_NUM_STAMPS];
+static u8 bootStampsValid; // Bit per BootStamp
+
+
+
+s32 benchmarkCrypto(BenchResult *const results, u32 num)
+{
+	u32 cmdBuf[2];
+	cmdBuf[0] = (u32)results;
+	cmdBuf[1] = num * sizeof(BenchResult);
+
+	return PXI_sendCmd(IPC_CMD9_BENCHMARK_CRYPTO, cmdBuf, 2);
+}
+
+s32 selftestCrypto(void)
+{
+	return PXI_sendCmd(IPC_CMD9_SELFTEST_CRYPTO, NULL, 0);
+}
+
+s32 benchmarkHash(BenchResult *const results, u32 num)
+{
+	static const u8 hashModes[3] = {HASH_MODE_1, HASH_MODE_224, HASH_MODE_256};
+
+
+	if(num < (BENCH_NUM_TESTS - BENCH_ARM9_TESTS) * BENCH_NUM_SIZES) return -1;
+
+	// Take what we can get. Bigger sizes are skipped.
+	u32 bufSize = BENCH_MAX_SIZE;
+	u32 *buf;
+	while(!(buf = (u32*)malloc(bufSize)))
+	{
+		bufSize >>= 1;
+		if(bufSize < BENCH_MIN_SIZE) return -2;
+	}
+
+	u32 n = 0;
+	for(u32 test = BENCH_ARM9_TESTS; test < BENCH_NUM_TESTS; test++)
+	{
+		for(u32 size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size <<= 1)
+		{
+			BenchResult *const res = &results[n++];
+			res->test = test;
+			res->size = size;
+			res->calls = 0;
+			res->ticks = 0;
+
+			if(size > bufSize) continue;
+
+			const u32 calls = (size < BENCH_MIN_BYTES ? BENCH_MIN_BYTES / size : 1);
+			const u8 params = HASH_INPUT_BIG | hashModes[test - BENCH_HASH1];
+			u32 hashOut[8];
+
+			// The timer counts down
+			TIMER_start(1, 0xFFFFFFFFu, false, false);
+			for(u32 i = 0; i < calls; i++) hash(buf, size, hashOut, params, HASH_OUTPUT_BIG);
+			res->ticks = 0xFFFFFFFFu - TIMER_stop();
+			res->calls = calls;
+		}
+	}
+
+	free(buf);
+
+	return n;
+}
+
+void benchmarkSaveLzStubInfo(void)
+{
+	memcpy(&lzStubInfo, (const void*)A11_LZSTUB_ENTRY, sizeof(LzStubInfo));
+}
+
+const LzStubInfo* benchmarkGetLzStubInfo(void)
+{
+	return &lzStubInfo;
+}
+
+void benchmarkBootStamp(BootStamp stamp)
+{
+	if(stamp == BOOT_STAMP_START)
+	{
+		// Reset all counters, cycle counter divided by 64
+		startProfiling(0, 0, true, 3);
+		bootStampsValid = 0;
+	}
+	if(bootStampsValid & 1u<<stamp) return;
+
+	bootStamps[stamp] = getCcnt();
+	bootStampsValid |= 1u<<stamp;
+}
+
+bool benchmarkGetBootTime(BootStamp stamp, u32 *const us)
+{
+	const u32 needed = 1u<<BOOT_STAMP_START | 1u<<stamp;
+	if((bootStampsValid & needed) != needed) return false;
+
+	const u32 ticks = bootStamps[stamp] - bootStamps[BOOT_STAMP_START];
+	*us = (u32)((u64)ticks * 1000000 / BOOT_STAMP_FREQ);
+
+	return true;
+}
+
+bool benchmarkWriteBootLog(const char *const path)
+{
+	static const char *const stampNames[BOOT_NUM_STAMPS] = {"boot start", "first splash", "firm launch"};
+	char log[128];
+
+
+	u32 len = ee_snprintf(log, sizeof(log), "stamp;us\n");
+	for(u32 i = 0; i < BOOT_NUM_STAMPS; i++)
+	{
+		u32 us;
+		if(!benchmarkGetBootTime(i, &us)) continue;
+		len += ee_snprintf(log + len, sizeof(log) - len, "%s;%lu\n", stampNames[i], us);
+	}
+
+	return fsQuickCreate(path, log, len);
+}
@@ -93,7 +93,8 @@ static const char *keyStrings[] = {
 	"DEV_MODE",
 	"RAM_FIRM_BOOT",
 
-	"SPLASH_DURATION"
+	"SPLASH_DURATION",
+	"FIRM_CACHE"
 	
 	/*
 	"BOOT_OPTION1_NAND_IMAGE",
@@ -125,7 +126,7 @@ static const FunctionsEntryType *getKeyFunctions(int key)
 		return &keyFunctions[1];
 	if(key == KBootMode)
 		return &keyFunctions[2];
-	if(key == KDevMode || key == KRamFirmBoot)
+	if(key == KDevMode || key == KRamFirmBoot || key == KFirmCache)
 		return &keyFunctions[3];
 	if(key == KSplashDuration)
 		return &keyFunctions[4];
@@ -192,13 +193,12 @@ bool loadConfigFile()
 			return false;
 	}
 	
-	fileSize = fileStat.fsize;
-	
-	if(fileSize > MAX_FILE_SIZE)
+	if(fileStat.fsize > MAX_FILE_SIZE)
 	{
 		//ee_printf("Invalid config-file size!\n");
 		return false;
 	}
+	fileSize = fileStat.fsize;
 	
 	filebuf = (char *) malloc(MAX_FILE_SIZE + 1);
 	
@@ -1188,3 +1188,8 @@ bool configRamFirmBootEnabled()
 {
 	return safeReadBoolKey(KRamFirmBoot);
 }
+
+bool configFirmCacheEnabled()
+{
+	return safeReadBoolKey(KFirmCache);
+}
@@ -55,6 +55,21 @@ s32 loadVerifyFirm(const char *const path, bool skipHashCheck)
 	return PXI_sendCmd(IPC_CMD9_LOAD_VERIFY_FIRM, cmdBuf, 3);
 }
 
+s32 prefetchFirm(const char *const path)
+{
+	u32 cmdBuf[2];
+	cmdBuf[0] = (u32)path;
+	cmdBuf[1] = strlen(path) + 1;
+
+	return PXI_sendCmd(IPC_CMD9_PREFETCH_FIRM, cmdBuf, 2);
+}
+
+s32 enableFirmCache(bool enable)
+{
+	const u32 cmdBuf = enable;
+	return PXI_sendCmd(IPC_CMD9_ENABLE_FIRM_CACHE, &cmdBuf, 1);
+}
+
 noreturn void firmLaunch(void)
 {
 	PXI_sendCmd(IPC_CMD9_FIRM_LAUNCH, NULL, 0);
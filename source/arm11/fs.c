@@ -16,24 +16,99 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include "types.h"
 #include "fs.h"
 #include "ipc_handler.h"
 #include "hardware/pxi.h"
+#include "hardware/cache.h"
 
 
+typedef struct
+{
+	s32 handle;
+	bool used;
+	bool writable;
+	bool written;
+	char *path;   // Writable files only. NULL if strdup() failed.
+} OpenFile;
+
+static const char *const drivePaths[FS_MAX_DRIVES] = {FS_DRIVE_NAMES};
+static FsChangeCallback changeCb = NULL;
+// The ARM9 hands out at most FS_MAX_FILES file handles so every open file
+// has an entry. Handles missing here are treated as written on every write.
+static OpenFile openFiles[FS_MAX_FILES] = {0};
+
+
+
+void fSetChangeCallback(FsChangeCallback cb)
+{
+	changeCb = cb;
+}
+
+static void notifyChange(const char *const path)
+{
+	if(changeCb) changeCb(path);
+}
+
+// For writes to files without a known path
+static void notifyFileChange(const OpenFile *const of)
+{
+	notifyChange(of && of->path ? of->path : "");
+}
+
+static void trackFile(s32 handle, const char *const path, bool writable)
+{
+	for(u32 i = 0; i < FS_MAX_FILES; i++)
+	{
+		if(openFiles[i].used) continue;
+
+		openFiles[i].handle = handle;
+		openFiles[i].used = true;
+		openFiles[i].writable = writable;
+		openFiles[i].written = false;
+		openFiles[i].path = (writable ? strdup(path) : NULL);
+		break;
+	}
+}
+
+static OpenFile* findFile(s32 handle)
+{
+	for(u32 i = 0; i < FS_MAX_FILES; i++)
+	{
+		if(openFiles[i].used && openFiles[i].handle == handle) return &openFiles[i];
+	}
+
+	return NULL;
+}
+
+// Notifies on the first write. fClose() notifies again with the final size.
+// Files without a path notify on every write.
+static void noteWrite(s32 handle)
+{
+	OpenFile *const of = findFile(handle);
+	if(of && !of->writable) return;
+	if(!of || !of->path || !of->written) notifyFileChange(of);
+	if(of) of->written = true;
+}
 
 s32 fMount(FsDrive drive)
 {
 	const u32 cmdBuf = drive;
-	return PXI_sendCmd(IPC_CMD9_FMOUNT, &cmdBuf, 1);
+	const s32 res = PXI_sendCmd(IPC_CMD9_FMOUNT, &cmdBuf, 1);
+	if(res == 0) notifyChange(drivePaths[drive]);
+
+	return res;
 }
 
 s32 fUnmount(FsDrive drive)
 {
 	const u32 cmdBuf = drive;
-	return PXI_sendCmd(IPC_CMD9_FUNMOUNT, &cmdBuf, 1);
+	const s32 res = PXI_sendCmd(IPC_CMD9_FUNMOUNT, &cmdBuf, 1);
+	if((u32)drive < FS_MAX_DRIVES) notifyChange(drivePaths[drive]);
+
+	return res;
 }
 
 bool fIsDriveMounted(FsDrive drive)
@@ -107,7 +182,35 @@ s32 fsWriteFromDeviceBuffer(s32 destHandle, u32 destOffset, u32 destSize, DevBuf
 	cmdBuf[2] = destSize;
 	cmdBuf[3] = devBufHandle;
 
-	return PXI_sendCmd(IPC_CMD9_FWRITE_FROM_DEV_BUF, cmdBuf, 4);
+	const s32 res = PXI_sendCmd(IPC_CMD9_FWRITE_FROM_DEV_BUF, cmdBuf, 4);
+	noteWrite(destHandle);
+
+	return res;
+}
+
+s32 fReadToDeviceBufferV(s32 sourceHandle, const FsIoVec *vec, u32 num, DevBufHandle devBufHandle)
+{
+	u32 cmdBuf[4];
+	cmdBuf[0] = (u32)vec;
+	cmdBuf[1] = sizeof(FsIoVec) * num;
+	cmdBuf[2] = sourceHandle;
+	cmdBuf[3] = devBufHandle;
+
+	return PXI_sendCmd(IPC_CMD9_FREADV_TO_DEV_BUF, cmdBuf, 4);
+}
+
+s32 fsWriteFromDeviceBufferV(s32 destHandle, const FsIoVec *vec, u32 num, DevBufHandle devBufHandle)
+{
+	u32 cmdBuf[4];
+	cmdBuf[0] = (u32)vec;
+	cmdBuf[1] = sizeof(FsIoVec) * num;
+	cmdBuf[2] = destHandle;
+	cmdBuf[3] = devBufHandle;
+
+	const s32 res = PXI_sendCmd(IPC_CMD9_FWRITEV_FROM_DEV_BUF, cmdBuf, 4);
+	noteWrite(destHandle);
+
+	return res;
 }
 
 s32 fOpen(const char *const path, FsOpenMode mode)
@@ -117,7 +220,14 @@ s32 fOpen(const char *const path, FsOpenMode mode)
 	cmdBuf[1] = strlen(path) + 1;
 	cmdBuf[2] = mode;
 
-	return PXI_sendCmd(IPC_CMD9_FOPEN, cmdBuf, 3);
+	const s32 handle = PXI_sendCmd(IPC_CMD9_FOPEN, cmdBuf, 3);
+	if(handle < 0) return handle;
+
+	trackFile(handle, path, mode & FS_OPEN_WRITE);
+	// May have created or truncated the file
+	if(mode & ~FS_OPEN_READ) notifyChange(path);
+
+	return handle;
 }
 
 s32 fRead(s32 handle, void *const buf, u32 size)
@@ -137,7 +247,40 @@ s32 fWrite(s32 handle, const void *const buf, u32 size)
 	cmdBuf[1] = size;
 	cmdBuf[2] = handle;
 
-	return PXI_sendCmd(IPC_CMD9_FWRITE, cmdBuf, 3);
+	const s32 res = PXI_sendCmd(IPC_CMD9_FWRITE, cmdBuf, 3);
+	noteWrite(handle);
+
+	return res;
+}
+
+s32 fReadV(s32 handle, const FsIoVec *vec, u32 num)
+{
+	u32 cmdBuf[3];
+	cmdBuf[0] = (u32)vec;
+	cmdBuf[1] = sizeof(FsIoVec) * num;
+	cmdBuf[2] = handle;
+
+	// The extent buffers are not IPC buffers so we have to take care of them.
+	for(u32 i = 0; i < num; i++) invalidateDCacheRange(vec[i].buf, vec[i].size);
+	const s32 res = PXI_sendCmd(IPC_CMD9_FREADV, cmdBuf, 3);
+	for(u32 i = 0; i < num; i++) invalidateDCacheRange(vec[i].buf, vec[i].size);
+
+	return res;
+}
+
+s32 fWriteV(s32 handle, const FsIoVec *vec, u32 num)
+{
+	u32 cmdBuf[3];
+	cmdBuf[0] = (u32)vec;
+	cmdBuf[1] = sizeof(FsIoVec) * num;
+	cmdBuf[2] = handle;
+
+	for(u32 i = 0; i < num; i++) flushDCacheRange(vec[i].buf, vec[i].size);
+
+	const s32 res = PXI_sendCmd(IPC_CMD9_FWRITEV, cmdBuf, 3);
+	noteWrite(handle);
+
+	return res;
 }
 
 s32 fSync(s32 handle)
@@ -146,40 +289,68 @@ s32 fSync(s32 handle)
 	return PXI_sendCmd(IPC_CMD9_FSYNC, &cmdBuf, 1);
 }
 
-s32 fLseek(s32 handle, u32 offset)
+s32 fLseek(s32 handle, u64 offset)
 {
-	u32 cmdBuf[2];
+	u32 cmdBuf[3];
 	cmdBuf[0] = handle;
 	cmdBuf[1] = offset;
+	cmdBuf[2] = offset>>32;
 
-	return PXI_sendCmd(IPC_CMD9_FLSEEK, cmdBuf, 2);
+	return PXI_sendCmd(IPC_CMD9_FLSEEK, cmdBuf, 3);
 }
 
-u32 fTell(s32 handle)
+u64 fTell(s32 handle)
 {
-	const u32 cmdBuf = handle;
-	return PXI_sendCmd(IPC_CMD9_FTELL, &cmdBuf, 1);
+	u64 pos;
+	u32 cmdBuf[3];
+	cmdBuf[0] = (u32)&pos;
+	cmdBuf[1] = sizeof(pos);
+	cmdBuf[2] = handle;
+
+	PXI_sendCmd(IPC_CMD9_FTELL, cmdBuf, 3);
+	return pos;
 }
 
-u32 fSize(s32 handle)
+u64 fSize(s32 handle)
 {
-	const u32 cmdBuf = handle;
-	return PXI_sendCmd(IPC_CMD9_FSIZE, &cmdBuf, 1);
+	u64 size;
+	u32 cmdBuf[3];
+	cmdBuf[0] = (u32)&size;
+	cmdBuf[1] = sizeof(size);
+	cmdBuf[2] = handle;
+
+	PXI_sendCmd(IPC_CMD9_FSIZE, cmdBuf, 3);
+	return size;
 }
 
 s32 fClose(s32 handle)
 {
 	const u32 cmdBuf = handle;
-	return PXI_sendCmd(IPC_CMD9_FCLOSE, &cmdBuf, 1);
+	const s32 res = PXI_sendCmd(IPC_CMD9_FCLOSE, &cmdBuf, 1);
+
+	OpenFile *const of = findFile(handle);
+	if(!of || of->written) notifyFileChange(of);
+	if(of)
+	{
+		free(of->path);
+		of->path = NULL;
+		of->used = false;
+	}
+
+	return res;
 }
 
-s32 fExpand(s32 handle, u32 size)
+s32 fExpand(s32 handle, u64 size)
 {
-	u32 cmdBuf[2];
+	u32 cmdBuf[3];
 	cmdBuf[0] = handle;
 	cmdBuf[1] = size;
+	cmdBuf[2] = size>>32;
+
+	const s32 res = PXI_sendCmd(IPC_CMD9_FEXPAND, cmdBuf, 3);
+	noteWrite(handle);
 
-	return PXI_sendCmd(IPC_CMD9_FEXPAND, cmdBuf, 2);
+	return res;
 }
 
 s32 fStat(const char *const path, FsFileInfo *fi)
@@ -225,7 +396,10 @@ s32 fMkdir(const char *const path)
 	cmdBuf[0] = (u32)path;
 	cmdBuf[1] = strlen(path) + 1;
 
-	return PXI_sendCmd(IPC_CMD9_FMKDIR, cmdBuf, 2);
+	const s32 res = PXI_sendCmd(IPC_CMD9_FMKDIR, cmdBuf, 2);
+	if(res == 0) notifyChange(path);
+
+	return res;
 }
 
 s32 fRename(const char *const old, const char *const new)
@@ -236,7 +410,14 @@ s32 fRename(const char *const old, const char *const new)
 	cmdBuf[2] = (u32)new;
 	cmdBuf[3] = strlen(new) + 1;
 
-	return PXI_sendCmd(IPC_CMD9_FRENAME, cmdBuf, 4);
+	const s32 res = PXI_sendCmd(IPC_CMD9_FRENAME, cmdBuf, 4);
+	if(res == 0)
+	{
+		notifyChange(old);
+		notifyChange(new);
+	}
+
+	return res;
 }
 
 s32 fUnlink(const char *const path)
@@ -245,7 +426,10 @@ s32 fUnlink(const char *const path)
 	cmdBuf[0] = (u32)path;
 	cmdBuf[1] = strlen(path) + 1;
 
-	return PXI_sendCmd(IPC_CMD9_FUNLINK, cmdBuf, 2);
+	const s32 res = PXI_sendCmd(IPC_CMD9_FUNLINK, cmdBuf, 2);
+	if(res == 0) notifyChange(path);
+
+	return res;
 }
 
 s32 fVerifyNandImage(const char *const path)
@@ -262,3 +446,9 @@ s32 fSetNandProtection(bool protect)
 	const u32 cmdBuf = protect;
 	return PXI_sendCmd(IPC_CMD9_FSET_NAND_PROT, &cmdBuf, 1);
 }
+
+s32 fDiscardFreeSpace(FsDrive drive)
+{
+	const u32 cmdBuf = drive;
+	return PXI_sendCmd(IPC_CMD9_FDISCARD_FREE, &cmdBuf, 1);
+}
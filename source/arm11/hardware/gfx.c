@@ -116,6 +116,12 @@ static void waitLcdsReady(void);
 static void gfxIrqHandler(u32 intSource);
 
 void GFX_init(GfxFbFmt fmtTop, GfxFbFmt fmtBot)
+{
+	GFX_initLcds(fmtTop, fmtBot);
+	GFX_powerOnBacklights();
+}
+
+void GFX_initLcds(GfxFbFmt fmtTop, GfxFbFmt fmtBot)
 {
 	setupFramebufs(fmtTop, fmtBot);
 
@@ -155,9 +161,10 @@ void GFX_init(GfxFbFmt fmtTop, GfxFbFmt fmtBot)
 	IRQ_registerHandler(IRQ_PPF, 14, 0, true, gfxIrqHandler);
 	IRQ_registerHandler(IRQ_P3D, 14, 0, true, gfxIrqHandler);
 
-	// Clear entire VRAM.
-	GX_memoryFill((u32*)VRAM_BANK0, 1u<<9, VRAM_SIZE / 2, 0,
-	              (u32*)VRAM_BANK1, 1u<<9, VRAM_SIZE / 2, 0);
+	// Clear the framebuffer part of VRAM. The rest is the ARM9 FIRM buffer
+	// which may already hold a prefetched FIRM.
+	GX_memoryFill((u32*)VRAM_BANK0, 1u<<9, 0x100000, 0,
+	              (u32*)(VRAM_BANK0 + 0x100000), 1u<<9, 0x100000, 0);
 
 	// Backlight and other stuff.
 	REG_LCD_ABL0_LIGHT = 0;
@@ -180,15 +187,23 @@ void GFX_init(GfxFbFmt fmtTop, GfxFbFmt fmtBot)
 	GX_textureCopy((u32*)RENDERBUF_TOP, 0, (u32*)RENDERBUF_BOT, 0, 16);
 
 	waitLcdsReady();
+	g_gfxState.lcdPower = 1; // LCDs on.
+
+	// Make sure the fills finished.
+	GFX_waitForEvent(GFX_EVENT_PSC0, false);
+	GFX_waitForEvent(GFX_EVENT_PSC1, false);
+}
+
+void GFX_powerOnBacklights(void)
+{
+	if(g_gfxState.lcdPower != 1) return; // LCDs off or backlights already on.
+
 	REG_LCD_ABL0_LIGHT_PWM = 0x1023E;
 	REG_LCD_ABL1_LIGHT_PWM = 0x1023E;
 	MCU_controlLCDPower(0x28u); // Power on backlights.
 	if(MCU_waitEvents(0x3Fu<<24) != 0x28u<<24) panic();
 	g_gfxState.lcdPower = 0x15; // All on.
 
-	// Make sure the fills finished.
-	GFX_waitForEvent(GFX_EVENT_PSC0, false);
-	GFX_waitForEvent(GFX_EVENT_PSC1, false);
 	REG_LCD_ABL0_FILL = 0;
 	REG_LCD_ABL1_FILL = 0;
 
@@ -208,6 +223,7 @@ void GFX_deinit(void)
 		MCU_controlLCDPower(1u);
 		if(MCU_waitEvents(0x3Fu<<24) != 1u<<24) panic();
 	}
+	g_gfxState.lcdPower = 0;
 	GFX_setBrightness(0, 0);
 	REG_LCD_ABL0_LIGHT_PWM = 0;
 	REG_LCD_ABL1_LIGHT_PWM = 0;
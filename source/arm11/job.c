@@ -0,0 +1,35 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "types.h"
+#include "job.h"
+#include "hardware/pxi.h"
+#include "ipc_handler.h"
+
+
+
+s32 JOB_getStatus(JobHandle handle, JobStatus *const status)
+{
+	u32 cmdBuf[3];
+	cmdBuf[0] = (u32)status;
+	cmdBuf[1] = sizeof(JobStatus);
+	cmdBuf[2] = handle;
+
+	return PXI_sendCmd(IPC_CMD9_JOB_GET_STATUS, cmdBuf, 3);
+}
@@ -32,6 +32,7 @@
 #include "arm11/firm.h"
 #include "arm11/fmt.h"
 #include "arm11/power.h"
+#include "benchmark.h"
 #include "firmwriter.h"
 #include "hardware/gfx.h"
 #include "banner_spla.h"
@@ -48,6 +49,7 @@ int main(void)
 	bool show_menu = false;
 	bool dump_bootroms = __superhaxEnabled;
 	bool gfx_initialized = false;
+	bool lcds_powered = false;
 	u32 nextBootSlot = 0;
 	u32 menu_ret = MENU_OK;
 	
@@ -55,10 +57,25 @@ int main(void)
 	char* err_string = NULL;
 	
 	
+	// The LCD init clears the VRAM lzstub ran from
+	benchmarkSaveLzStubInfo();
+	benchmarkBootStamp(BOOT_STAMP_START);
+	
+	// The ARM9 mounts the filesystems on its own right after boot.
+	// Power up the LCDs meanwhile if we are likely going to show something.
+	// The backlights stay off until we know for sure.
+	hidScanInput();
+	if(!readStoredBootslot() || (hidGetExtraKeys(0) & KEY_HOME))
+	{
+		GFX_initLcds(GFX_RGB565, GFX_RGB565);
+		lcds_powered = true;
+	}
+	
 	// filesystem / load config
+	// (the NAND filesystems are mounted by the ARM9 on first access)
 	fsMountSdmc();
-	fsMountNandFilesystems();
 	loadConfigFile();
+	enableFirmCache(configFirmCacheEnabled());
 
 
 	hidScanInput();
@@ -92,11 +109,29 @@ int main(void)
 	// show menu if bootmode is normal or HOME button is pressed
 	show_menu = (!nextBootSlot && (bootmode == BootModeNormal)) || hidGetExtraKeys(0) & KEY_HOME;
 	
+	// let the ARM9 load the FIRM we are most likely going to boot while we draw the splash
+	if(!show_menu)
+	{
+		for(u32 i = 0; i < N_BOOTSLOTS; i++)
+		{
+			const u32 slot = (nextBootSlot ? nextBootSlot - 1 : i);
+			if(configDataExist(KBootOption1 + slot) &&
+			   (nextBootSlot || !configDataExist(KBootOption1Buttons + slot)))
+			{
+				prefetchFirm((char*) configGetData(KBootOption1 + slot));
+				break;
+			}
+			if(nextBootSlot) break;
+		}
+	}
+	
 	// show splash if cold boot and (bootmode != BootModeQuiet)
 	bool splash_wait = false;
 	if(show_menu || (!nextBootSlot && (bootmode != BootModeQuiet)))
 	{
-		if (!gfx_initialized) GFX_init(GFX_RGB565, GFX_RGB565);
+		if (!lcds_powered) GFX_initLcds(GFX_RGB565, GFX_RGB565);
+		GFX_powerOnBacklights();
+		lcds_powered = true;
 		gfx_initialized = true;
 		if(configDataExist(KSplashScreen))
 		{
@@ -127,6 +162,7 @@ int main(void)
 			}
 		}
 		updateScreens();
+		benchmarkBootStamp(BOOT_STAMP_SPLASH);
 	}
 	
 	
@@ -242,7 +278,9 @@ menu_start: ;
 		{
 			if(!gfx_initialized)
 			{
-				GFX_init(GFX_RGB565, GFX_RGB565);
+				if(!lcds_powered) GFX_initLcds(GFX_RGB565, GFX_RGB565);
+				GFX_powerOnBacklights();
+				lcds_powered = true;
 				gfx_initialized = true;
 			}
 			// init and select terminal console
@@ -390,6 +428,13 @@ menu_end:
 	/* We are going to turn off our console or boot    */
 	/* into a new firmware.							   */
 	
+	// boot timings for dev mode, the last chance while the SD card is mounted
+	if (startFirmLaunch && configDevModeEnabled())
+	{
+		benchmarkBootStamp(BOOT_STAMP_LAUNCH);
+		benchmarkWriteBootLog("sdmc:/3ds/fb3ds_boot.csv");
+	}
+	
 	// write config (if something changed)
 	if (configHasChanged()) writeConfigFile();
 	
@@ -399,6 +444,7 @@ menu_end:
 		if(firm_err == 1) GFX_setFramebufFmt(GFX_BGR8, GFX_BGR8);
 		else              GFX_deinit();
 	}
+	else if(lcds_powered) GFX_deinit(); // powered up for nothing
 	
 	// deinit filesystem
 	fsUnmountAll();
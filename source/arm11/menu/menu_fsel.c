@@ -35,14 +35,26 @@
 #include "arm11/fmt.h"
 
 #define MAX_DIR_ENTRIES	0x100 // 256 -> worst case approx 64kiB (yes, this is limited)
-#define N_DIR_READ		0x10  // 16 at a time
+#define N_DIR_READ		0x40  // 64 at a time (one IPC each)
+#define DIR_CACHE_SLOTS	4     // sorted listings kept for going back and forth
 
 typedef struct {
-	u32 fsize;		// size of the file
+	u64 fsize;		// size of the file
 	u8  is_dir;		// > 0 if is directory
 	char* fname;	// filename (handle via malloc)
 } DirBufferEntry;
 
+typedef struct {
+	char* path;					// NULL if the slot is unused
+	char* pattern;				// NULL if listed without pattern
+	DirBufferEntry* entries;	// owns the filenames
+	s32 n_entries;
+	u32 last_use;
+} DirCacheSlot;
+
+static DirCacheSlot dir_cache[DIR_CACHE_SLOTS];
+static u32 dir_cache_tick = 0;
+
 
 
 // inspired by http://www.geeksforgeeks.org/wildcard-character-matching/
@@ -138,6 +150,103 @@ static void sortDirBuffer(DirBufferEntry* dir_buffer, s32 n_entries)
 }
 
 
+static void dirCacheFreeSlot(DirCacheSlot* slot)
+{
+	freeDirBufferContent(slot->entries, slot->n_entries);
+	free(slot->entries);
+	free(slot->path);
+	free(slot->pattern);
+	memset(slot, 0, sizeof(DirCacheSlot));
+}
+
+
+/**
+ * @brief Drops cached listings affected by a change to path. These are the
+ *        parent dir of path and path itself including everything below it.
+ *        Registered as FS change callback.
+ * @param path Path of the changed file or dir. Empty drops everything.
+ */
+static void dirCacheInvalidate(const char* path)
+{
+	u32 len = strlen(path);
+	while (len && (path[len-1] == '/')) len--;
+	
+	u32 parent_len = len;
+	while (parent_len && (path[parent_len-1] != '/')) parent_len--;
+	if (parent_len) parent_len--; // drop the '/'
+	
+	for (u32 i = 0; i < DIR_CACHE_SLOTS; i++)
+	{
+		DirCacheSlot* slot = &(dir_cache[i]);
+		if (!slot->path) continue;
+		
+		const u32 slen = strlen(slot->path);
+		bool is_parent = parent_len && (slen == parent_len) &&
+			(strnicmp(slot->path, path, parent_len) == 0);
+		bool is_below = (slen >= len) && (strnicmp(slot->path, path, len) == 0) &&
+			(!len || (slot->path[len] == '\0') || (slot->path[len] == '/'));
+		
+		if (is_parent || is_below)
+			dirCacheFreeSlot(slot);
+	}
+}
+
+
+static DirBufferEntry* dirCacheLookup(const char* path, const char* pattern, s32* n_entries)
+{
+	for (u32 i = 0; i < DIR_CACHE_SLOTS; i++)
+	{
+		DirCacheSlot* slot = &(dir_cache[i]);
+		if (!slot->path || (strcmp(slot->path, path) != 0))
+			continue;
+		if ((!slot->pattern != !pattern) || (pattern && (strcmp(slot->pattern, pattern) != 0)))
+			continue;
+		
+		slot->last_use = ++dir_cache_tick;
+		*n_entries = slot->n_entries;
+		return slot->entries;
+	}
+	
+	return NULL;
+}
+
+
+/**
+ * @brief Moves a listing into the cache, evicting the least recently used one.
+ * @return The cached copy or NULL if out of memory. On success the filenames
+ *         belong to the cache and must not be freed from dir_buffer.
+ */
+static DirBufferEntry* dirCacheInsert(const char* path, const char* pattern, const DirBufferEntry* dir_buffer, s32 n_entries)
+{
+	DirCacheSlot* slot = &(dir_cache[0]);
+	for (u32 i = 1; i < DIR_CACHE_SLOTS; i++)
+	{
+		if (!slot->path) break;
+		if (!dir_cache[i].path || (dir_cache[i].last_use < slot->last_use))
+			slot = &(dir_cache[i]);
+	}
+	if (slot->path) dirCacheFreeSlot(slot);
+	
+	slot->path = strdup(path);
+	slot->pattern = pattern ? strdup(pattern) : NULL;
+	slot->entries = (DirBufferEntry*) malloc((n_entries ? n_entries : 1) * sizeof(DirBufferEntry));
+	if (!slot->path || (pattern && !slot->pattern) || !slot->entries)
+	{
+		free(slot->path);
+		free(slot->pattern);
+		free(slot->entries);
+		memset(slot, 0, sizeof(DirCacheSlot));
+		return NULL;
+	}
+	
+	memcpy(slot->entries, dir_buffer, n_entries * sizeof(DirBufferEntry));
+	slot->n_entries = n_entries;
+	slot->last_use = ++dir_cache_tick;
+	
+	return slot->entries;
+}
+
+
 static s32 readDirToBuffer(DirBufferEntry* dir_buffer, const char* path, const char* pattern)
 {
 	s32 n_entries = 0;
@@ -325,6 +434,9 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 	dir_buffer = (DirBufferEntry*) malloc(MAX_DIR_ENTRIES * sizeof(DirBufferEntry));
 	if (!dir_buffer) return false;
 	
+	// writes through the FS API drop stale listings
+	fSetChangeCallback(dirCacheInvalidate);
+	
 	// res_path has to be at least 256 byte long (including '\0') and
 	// is also used as temporary buffer
 	*res_path = '\0'; // root dir if start is NULL
@@ -364,7 +476,19 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 	bool is_dir = true; // we are not finished while we have a dir in res_path
 	while(is_dir && result)
 	{
-		s32 n_entries = readDirToBuffer(dir_buffer, res_path, pattern);
+		// root is not cached, it depends on mounts and dev mode
+		s32 n_entries = 0;
+		DirBufferEntry* dir_list = *res_path ? dirCacheLookup(res_path, pattern, &n_entries) : NULL;
+		if (!dir_list)
+		{
+			dir_list = dir_buffer;
+			n_entries = readDirToBuffer(dir_buffer, res_path, pattern);
+			if (*res_path && (n_entries >= 0))
+			{
+				DirBufferEntry* cached = dirCacheInsert(res_path, pattern, dir_buffer, n_entries);
+				if (cached) dir_list = cached;
+			}
+		}
 		s32 last_index = (u32) -1;
 		s32 scroll = 0;
 		s32 index = 0;
@@ -385,7 +509,7 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 		{
 			for (s32 i = 0; i < n_entries; i++)
 			{
-				if (strncmp(dir_buffer[i].fname, lastname, FF_MAX_LFN + 1) == 0)
+				if (strncmp(dir_list[i].fname, lastname, FF_MAX_LFN + 1) == 0)
 				{
 					index = i;
 					break;
@@ -399,7 +523,7 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 		{
 			// update file browser (on demand)
 			if (index != last_index) {
-				browserDraw(res_path, dir_buffer, n_entries, menu_con, index, &scroll);
+				browserDraw(res_path, dir_list, n_entries, menu_con, index, &scroll);
 				last_index = index;
 				updateScreens(); // update screens (VBlank included)
 			} else GFX_waitForEvent(GFX_EVENT_PDC0, true); // VBlank
@@ -436,10 +560,10 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 				// build new res_path
 				char* name = &(res_path[strlen(res_path)]);
 				if (name > res_path) *(name++) = '/';
-				strncpy(name, dir_buffer[index].fname, ((FF_MAX_LFN + 1) - (name - res_path)));
+				strncpy(name, dir_list[index].fname, ((FF_MAX_LFN + 1) - (name - res_path)));
 				
 				// is this a dir? (override when X is detected)
-				is_dir = !(select_dirs && (kDown & KEY_X)) && dir_buffer[index].is_dir;
+				is_dir = !(select_dirs && (kDown & KEY_X)) && dir_list[index].is_dir;
 				
 				lastname = NULL;
 				break;
@@ -502,7 +626,8 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 			}
 		}
 		
-		freeDirBufferContent(dir_buffer, n_entries);
+		if (dir_list == dir_buffer)
+			freeDirBufferContent(dir_buffer, n_entries);
 	}
 	
 	free(dir_buffer);
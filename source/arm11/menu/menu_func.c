@@ -44,6 +44,7 @@
 #include "arm11/debug.h"
 #include "arm11/fmt.h"
 #include "arm11/firm.h"
+#include "benchmark.h"
 
 
 
@@ -99,6 +100,9 @@ u32 menuPresetBootConfig(void)
 	if (configRamFirmBootEnabled())
 		res |= 1 << (N_BOOTSLOTS+2);
 	
+	if (configFirmCacheEnabled())
+		res |= 1 << (N_BOOTSLOTS+3);
+	
 	return res;
 }
 
@@ -173,6 +177,18 @@ u32 menuSwitchFcramBoot(PrintConsole* term_con, PrintConsole* menu_con, u32 para
 	return res;
 }
 
+u32 menuSwitchFirmCache(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
+{
+	(void) term_con;
+	(void) menu_con;
+	(void) param;
+	bool cache_next = !configFirmCacheEnabled();
+	u32 res = (configSetKeyData(KFirmCache, &cache_next)) ? MENU_OK : MENU_FAIL;
+	enableFirmCache(configFirmCacheEnabled());
+	
+	return res;
+}
+
 u32 menuSetSplash(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 {
 	char* res_path = NULL;
@@ -624,10 +640,13 @@ u32 menuBackupNand(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 	}
 	
 	// reserve space for NAND backup
+	// (a contiguous file is written straight to the SD, bypassing the FAT;
+	// on exFAT it also needs no FAT chain at all)
 	ee_printf("NAND size: %lli MiB\nBuffer size: %lu kiB\nReserving space...\n",
 		nand_size / 0x0100000, (u32) DEVICE_BUFSIZE / 0x400);
 	updateScreens();
-	if ((fLseek(fHandle, nand_size) != 0) || (fTell(fHandle) != nand_size))
+	if ((fExpand(fHandle, nand_size) != 0) &&
+		((fLseek(fHandle, nand_size) != 0) || (fTell(fHandle) != (u64)nand_size)))
 	{
 		fClose(fHandle);
 		fUnlink(fpath);
@@ -1200,6 +1219,177 @@ u32 menuMoveConfig(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 	return result;
 }
 
+u32 menuDiscardFreeSpace(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
+{
+	(void) menu_con;
+	u32 result = MENU_FAIL;
+	
+	const bool isNand = (param == FS_DRIVE_NAND);
+	const char *const drv = isNand ? "nand:" : "sdmc:";
+	
+	// select & clear console
+	consoleSelect(term_con);
+	consoleClear();
+	
+	// ask the user for confirmation
+	if (!askConfirmation("Discard free space on %s?\nDeleted files can't be recovered afterwards.", isNand ? "NAND" : "SD card"))
+		return MENU_FAIL;
+	consoleClear();
+	
+	ee_printf(ESC_SCHEME_ACCENT1 "Discarding free space on %s\n" ESC_RESET "\nThis may take a while... ", drv);
+	updateScreens();
+	
+	if (!fsEnsureMounted(drv))
+	{
+		ee_printf(ESC_SCHEME_BAD "failed!\n" ESC_RESET);
+		ee_printf("%s\n", isNand ? "NAND may be corrupt!" : "SD not inserted or corrupt!");
+		goto fail;
+	}
+	
+	s32 res = fDiscardFreeSpace(param);
+	if (res < 0)
+	{
+		ee_printf(ESC_SCHEME_BAD "failed!\n" ESC_RESET);
+		if (res == FS_ERR_UNSUPPORTED)
+			ee_printf("Filesystem not supported.\n");
+		else
+			ee_printf("Discard error code %li!\n", res);
+		goto fail;
+	}
+	
+	ee_printf(ESC_SCHEME_GOOD "OK\n" ESC_RESET);
+	ee_printf("\nDiscarded %li MiB of free space.\n", res);
+	result = MENU_OK;
+	
+	
+	fail:
+	
+	ee_printf("\nPress B or HOME to return.");
+	updateScreens();
+	outputEndWait();
+	
+	
+	return result;
+}
+
+u32 menuCryptoBenchmark(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
+{
+	static const char *const testNames[BENCH_NUM_TESTS] = {
+		"ARM9 AES-CTR CPU", "ARM9 AES-CTR DMA32", "ARM9 AES-CTR DMA16",
+		"ARM9 SHA-1", "ARM9 SHA-224", "ARM9 SHA-256",
+		"ARM11 SHA-1", "ARM11 SHA-224", "ARM11 SHA-256"
+	};
+	const u32 numResults = BENCH_NUM_TESTS * BENCH_NUM_SIZES;
+	const u32 logSize = numResults * 64 + 128;
+
+	(void) menu_con;
+	(void) param;
+
+	u32 result = MENU_FAIL;
+
+	// clear console
+	consoleSelect(term_con);
+	consoleClear();
+	ee_printf(ESC_SCHEME_ACCENT1 "Crypto engine benchmark\n\n" ESC_RESET);
+	ee_printf("This takes a while...\n");
+	updateScreens();
+
+	// saved at boot, the LCD init clears VRAM
+	const LzStubInfo lzInfo = *benchmarkGetLzStubInfo();
+	
+	BenchResult *results = (BenchResult*) malloc(numResults * sizeof(BenchResult));
+	char *log = (char*) malloc(logSize);
+	if (!results || !log)
+	{
+		ee_printf(ESC_SCHEME_BAD "Out of memory!\n" ESC_RESET);
+		goto fail;
+	}
+
+	if ((benchmarkCrypto(results, BENCH_ARM9_TESTS * BENCH_NUM_SIZES) < 0) ||
+		(benchmarkHash(results + BENCH_ARM9_TESTS * BENCH_NUM_SIZES,
+			(BENCH_NUM_TESTS - BENCH_ARM9_TESTS) * BENCH_NUM_SIZES) < 0))
+	{
+		ee_printf(ESC_SCHEME_BAD "Benchmark failed!\n" ESC_RESET);
+		goto fail;
+	}
+
+	// full table goes to the log, a summary (16B, 512B, 64KiB, 4MiB) to the screen
+	u32 logLen = ee_snprintf(log, logSize, "test;bytes;calls;MB/s;cycles/call\n");
+	ee_printf("\n%-19.19s %7s %7s %7s %7s\n", "MB/s", "16B", "512B", "64K", "4M");
+	for (u32 t = 0; t < BENCH_NUM_TESTS; t++)
+	{
+		const u32 freq = (t < BENCH_ARM9_TESTS) ? BENCH_ARM9_TICK_FREQ : BENCH_ARM11_TICK_FREQ;
+		ee_printf("%-19.19s", testNames[t]);
+		for (u32 i = 0; i < BENCH_NUM_SIZES; i++)
+		{
+			const BenchResult* res = &results[t * BENCH_NUM_SIZES + i];
+			const bool summary = (res->size == 16) || (res->size == 512) ||
+				(res->size == 0x10000) || (res->size == BENCH_MAX_SIZE);
+			if (!res->calls || !res->ticks)
+			{
+				if (summary) ee_printf("     n/a");
+				continue;
+			}
+
+			// 10 KB/s units and CPU cycles (the timers run at half the CPU clock)
+			const u64 bytes = (u64) res->size * res->calls;
+			const u32 rate = (u32) (bytes * freq / res->ticks / 10000);
+			const u32 cycles = (u32) ((u64) res->ticks * 2 / res->calls);
+			if (summary) ee_printf(" %4lu.%02lu", rate / 100, rate % 100);
+			logLen += ee_snprintf(log + logLen, logSize - logLen, "%s;%lu;%lu;%lu.%02lu;%lu\n",
+				testNames[t], res->size, res->calls, rate / 100, rate % 100, cycles);
+		}
+		ee_printf("\n");
+	}
+	
+	// NIST SP 800-38A known answers for ARM9 AES-CBC and CBC-MAC (CPU and DMA)
+	const s32 kat = selftestCrypto();
+	ee_printf("\n%-20.20s", "AES-CBC KAT");
+	if (kat == 0) ee_printf(ESC_SCHEME_GOOD "passed\n" ESC_RESET);
+	else ee_printf(ESC_SCHEME_BAD "failed (check %li)!\n" ESC_RESET, -kat);
+	logLen += ee_snprintf(log + logLen, logSize - logLen, "AES-CBC KAT;;;;%li\n", kat);
+
+	// cold boot unpacking of the ARM11 binary vs. the bytes the bootrom didn't need to load
+	if ((lzInfo.magic == LZSTUB_MAGIC) && lzInfo.done && lzInfo.cycles)
+	{
+		const u32 rate = (u32) ((u64) lzInfo.size * BENCH_ARM11_TICK_FREQ * 2 / lzInfo.cycles / 10000);
+		const u32 us = (u32) ((u64) lzInfo.cycles * 1000000 / (BENCH_ARM11_TICK_FREQ * 2));
+		ee_printf("\nARM11 LZ11 boot: %lu -> %lu KiB, %lu us\n",
+			lzInfo.packedSize / 0x400, lzInfo.size / 0x400, us);
+		logLen += ee_snprintf(log + logLen, logSize - logLen, "ARM11 LZ11 boot;%lu;1;%lu.%02lu;%lu\nARM11 LZ11 packed;%lu;;;\n",
+			lzInfo.size, rate / 100, rate % 100, lzInfo.cycles, lzInfo.packedSize);
+	}
+
+	// this boot, the FIRM launch stamp goes to sdmc:/3ds/fb3ds_boot.csv in dev mode
+	u32 splashUs;
+	if (benchmarkGetBootTime(BOOT_STAMP_SPLASH, &splashUs))
+	{
+		ee_printf("Boot to first splash: %lu us\n", splashUs);
+		logLen += ee_snprintf(log + logLen, logSize - logLen, "Boot to first splash;;;;%lu\n", splashUs);
+	}
+	updateScreens();
+
+	ee_printf("\n%-20.20s", "Write log");
+	if (fsQuickCreate("sdmc:/3ds/fb3ds_bench.csv", log, logLen))
+	{
+		ee_printf(ESC_SCHEME_GOOD "success\n" ESC_RESET);
+		if (kat == 0) result = MENU_OK;
+	}
+	else ee_printf(ESC_SCHEME_BAD "failed!\n" ESC_RESET);
+
+
+	fail:
+
+	free(results);
+	free(log);
+
+	ee_printf("\nPress B or HOME to return.");
+	updateScreens();
+	outputEndWait();
+
+	return result;
+}
+
 u32 menuShowCredits(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 {
 	(void) menu_con;
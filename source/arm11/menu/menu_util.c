@@ -247,7 +247,7 @@ bool drawCustomSplash(const char* folder)
 	fHandle = fOpen(splash_path, FS_OPEN_EXISTING | FS_OPEN_READ);
 	if (fHandle >= 0)
 	{
-		u32 splash_size = fSize(fHandle);
+		const u64 splash_size = fSize(fHandle);
 		u16 *const splash_data = (u16*)(splash_buffer + splash_max_size + (30 * 1024) - splash_size);
 		if ((splash_size < sizeof(SplashHeader)) || (splash_size > splash_max_size) ||
 			(fRead(fHandle, splash_data, splash_size) != FR_OK))
@@ -266,7 +266,7 @@ bool drawCustomSplash(const char* folder)
 	fHandle = fOpen(splash_path, FS_OPEN_EXISTING | FS_OPEN_READ);
 	if (fHandle >= 0)
 	{
-		u32 splash_size = fSize(fHandle);
+		const u64 splash_size = fSize(fHandle);
 		u16 *const splash_data = (u16*)(splash_buffer + splash_max_size + (30 * 1024) - splash_size);
 		if ((splash_size < sizeof(SplashHeader)) || (splash_size > splash_max_size) ||
 			(fRead(fHandle, splash_data, splash_size) != FR_OK))
@@ -0,0 +1,214 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "mem_map.h"
+#include "benchmark.h"
+#include "crypto_kat.h"
+#include "util.h"
+#include "arm9/firm.h"
+#include "arm9/hardware/crypto.h"
+#include "arm9/hardware/timer.h"
+#include "hardware/cache.h"
+
+
+#define BENCH_BUF  ((u32*)FIRM_LOAD_ADDR)
+
+
+
+static void benchAesCtr(AES_ctx *const ctx, u32 size, BenchTest test)
+{
+	u32 *const buf = BENCH_BUF;
+	const u32 blocks = size / 16;
+
+	switch(test)
+	{
+		case BENCH_AES_CTR_CPU:
+			AES_ctr(ctx, buf, buf, blocks, false);
+			break;
+		case BENCH_AES_CTR_DMA32:
+			AES_ctr(ctx, buf, buf, blocks, true);
+			break;
+		case BENCH_AES_CTR_DMA16:
+			// An odd number of blocks makes the AES code use 16 bytes FIFO bursts
+			for(u32 done = 0; done < blocks; )
+			{
+				u32 num = min(blocks - done, 0xFFFFu);
+				if(!(num & 1u)) num--;
+				AES_ctr(ctx, buf + done * 4, buf + done * 4, num, true);
+				done += num;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static u32 runTest(BenchTest test, u32 size, u32 calls)
+{
+	static const u8 shaModes[3] = {SHA_MODE_1, SHA_MODE_224, SHA_MODE_256};
+	AES_ctx ctx;
+	u32 hash[8];
+
+
+	if(test <= BENCH_AES_CTR_DMA16)
+	{
+		// Key and counter don't matter. Keyslot 0x11 is always set up.
+		static const u32 ctr[4] = {0};
+		AES_selectKeyslot(0x11);
+		AES_setCryptParams(&ctx, AES_INPUT_BIG | AES_INPUT_NORMAL, AES_OUTPUT_BIG | AES_OUTPUT_NORMAL);
+		AES_setCtrIv(&ctx, AES_INPUT_BIG | AES_INPUT_NORMAL, ctr);
+		flushInvalidateDCacheRange(BENCH_BUF, size);
+	}
+
+	TIMER_startCounter32();
+	const u32 start = TIMER_getCounter32();
+	for(u32 i = 0; i < calls; i++)
+	{
+		if(test <= BENCH_AES_CTR_DMA16) benchAesCtr(&ctx, size, test);
+		else sha(BENCH_BUF, size, hash, SHA_INPUT_BIG | shaModes[test - BENCH_SHA1], SHA_OUTPUT_BIG);
+	}
+	const u32 ticks = TIMER_getCounter32() - start;
+	TIMER_stopCounter32();
+
+	return ticks;
+}
+
+s32 benchmarkCrypto(BenchResult *const results, u32 num)
+{
+	if(num < BENCH_ARM9_TESTS * BENCH_NUM_SIZES) return -1;
+
+	// The FIRM buffer is used as test data
+	invalidatePrefetchedFirm();
+
+	u32 n = 0;
+	for(u32 test = 0; test < BENCH_ARM9_TESTS; test++)
+	{
+		for(u32 size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size <<= 1)
+		{
+			BenchResult *const res = &results[n++];
+			res->test = test;
+			res->size = size;
+			res->calls = 0;
+			res->ticks = 0;
+
+			// 32 bytes bursts need an even number of blocks
+			if(test == BENCH_AES_CTR_DMA32 && size < 32) continue;
+
+			const u32 calls = (size < BENCH_MIN_BYTES ? BENCH_MIN_BYTES / size : 1);
+			res->ticks = runTest(test, size, calls);
+			res->calls = calls;
+		}
+	}
+
+	return n;
+}
+
+
+
+// Runs blocks through AES_cbc() in place split over 2 calls to test IV chaining.
+// Only flushes before each call like the API demands. No invalidate after.
+static void katCbc(AES_ctx *const ctx, u32 *const buf, u32 blocks, u32 first, bool enc, bool dma)
+{
+	AES_setCtrIv(ctx, AES_INPUT_BIG | AES_INPUT_NORMAL, (const u32*)katAesCbcIv);
+	if(dma) flushInvalidateDCacheRange(buf, first * 16);
+	AES_cbc(ctx, buf, buf, first, enc, dma);
+	if(first < blocks)
+	{
+		u32 *const rest = buf + first * 4;
+		if(dma) flushInvalidateDCacheRange(rest, (blocks - first) * 16);
+		AES_cbc(ctx, rest, rest, blocks - first, enc, dma);
+	}
+}
+
+static u32 katPattern(u32 i)
+{
+	return i * 0x9E3779B9u;
+}
+
+s32 selftestCrypto(void)
+{
+	static const u32 zeroIv[4] = {0};
+
+	// The FIRM buffer is used as test data. DMA can't access the stack (DTCM).
+	invalidatePrefetchedFirm();
+
+	u32 *const buf = BENCH_BUF;
+	AES_ctx ctx;
+	u32 mac[4];
+	s32 check = 0;
+
+	AES_setKey(0x11, AES_KEY_NORMAL, AES_INPUT_BIG | AES_INPUT_NORMAL, false, (const u32*)katAesKey);
+	AES_selectKeyslot(0x11);
+	AES_setCryptParams(&ctx, AES_INPUT_BIG | AES_INPUT_NORMAL, AES_OUTPUT_BIG | AES_OUTPUT_NORMAL);
+
+	// 1 call (32 bytes DMA bursts) and 1 + 3 blocks (16 bytes DMA bursts)
+	static const u8 splits[2] = {KAT_AES_BLOCKS, 1};
+	for(u32 dma = 0; dma < 2; dma++)
+	{
+		for(u32 i = 0; i < sizeof(splits); i++)
+		{
+			memcpy(buf, katAesPlain, sizeof(katAesPlain));
+			katCbc(&ctx, buf, KAT_AES_BLOCKS, splits[i], true, dma);
+			check--;
+			if(memcmp(buf, katAesCbcCipher, sizeof(katAesCbcCipher)) != 0) return check;
+
+			katCbc(&ctx, buf, KAT_AES_BLOCKS, splits[i], false, dma);
+			check--;
+			if(memcmp(buf, katAesPlain, sizeof(katAesPlain)) != 0) return check;
+		}
+
+		// The MAC over the whole message is the last ciphertext block
+		memcpy(buf, katAesPlain, sizeof(katAesPlain));
+		if(dma) flushDCacheRange(buf, sizeof(katAesPlain));
+		AES_setCtrIv(&ctx, AES_INPUT_BIG | AES_INPUT_NORMAL, (const u32*)katAesCbcIv);
+		AES_cbcMac(&ctx, buf, 1, mac, dma);
+		AES_cbcMac(&ctx, buf + 4, KAT_AES_BLOCKS - 1, mac, dma);
+		check--;
+		if(memcmp(mac, &katAesCbcCipher[sizeof(katAesCbcCipher) - 16], 16) != 0) return check;
+
+		AES_setCtrIv(&ctx, AES_INPUT_BIG | AES_INPUT_NORMAL, zeroIv);
+		AES_cbcMac(&ctx, buf, 1, mac, dma);
+		check--;
+		if(memcmp(mac, katAesCbcMacZeroIv, 16) != 0) return check;
+	}
+
+	// More than AES_MAX_BLOCKS. The IV must be carried over between chunks.
+	// The CPU MAC, DMA encryption in 1 call and DMA decryption in 2 calls must agree.
+	const u32 blocks = AES_MAX_BLOCKS + 3;
+	for(u32 i = 0; i < blocks * 4; i++) buf[i] = katPattern(i);
+
+	AES_setCtrIv(&ctx, AES_INPUT_BIG | AES_INPUT_NORMAL, (const u32*)katAesCbcIv);
+	AES_cbcMac(&ctx, buf, blocks, mac, false);
+
+	flushInvalidateDCacheRange(buf, blocks * 16);
+	AES_setCtrIv(&ctx, AES_INPUT_BIG | AES_INPUT_NORMAL, (const u32*)katAesCbcIv);
+	AES_cbc(&ctx, buf, buf, blocks, true, true);
+	check--;
+	if(memcmp(mac, &buf[blocks * 4 - 4], 16) != 0) return check;
+
+	katCbc(&ctx, buf, blocks, AES_MAX_BLOCKS / 2 + 1, false, true);
+	check--;
+	for(u32 i = 0; i < blocks * 4; i++)
+	{
+		if(buf[i] != katPattern(i)) return check;
+	}
+
+	return 0;
+}
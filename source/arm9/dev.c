@@ -26,6 +26,7 @@
 #include "arm9/hardware/sdmmc.h"
 #include "arm9/hardware/cfg9.h"
 #include "arm9/hardware/interrupt.h"
+#include "arm9/hardware/ndma.h"
 #include "fs.h"
 #include "arm9/hardware/crypto.h"
 #include "hardware/cache.h"
@@ -42,6 +43,7 @@ bool sdmmc_sd_write_sector(u32 sector, u32 count, const void *buf);
 bool sdmmc_sd_close(void);
 bool sdmmc_sd_is_active(void);
 u32  sdmmc_sd_get_sector_count(void);
+bool sdmmc_sd_trim_sector(u32 sector, u32 count);
 
 static dev_struct dev_sd = {
 	"sd",
@@ -51,7 +53,8 @@ static dev_struct dev_sd = {
 	sdmmc_sd_write_sector,
 	sdmmc_sd_close,
 	sdmmc_sd_is_active,
-	sdmmc_sd_get_sector_count
+	sdmmc_sd_get_sector_count,
+	sdmmc_sd_trim_sector
 };
 const dev_struct *dev_sdcard = &dev_sd;
 
@@ -63,6 +66,7 @@ bool sdmmc_rnand_write_sector(u32 sector, u32 count, const void *buf);
 bool sdmmc_rnand_close(void);
 bool sdmmc_rnand_is_active(void);
 u32  sdmmc_rnand_get_sector_count(void);
+bool sdmmc_rnand_trim_sector(u32 sector, u32 count);
 
 static dev_struct dev_rnand = {
 	"rnand",
@@ -72,18 +76,32 @@ static dev_struct dev_rnand = {
 	sdmmc_rnand_write_sector,
 	sdmmc_rnand_close,
 	sdmmc_rnand_is_active,
-	sdmmc_rnand_get_sector_count
+	sdmmc_rnand_get_sector_count,
+	sdmmc_rnand_trim_sector
 };
 const dev_struct *dev_rawnand = &dev_rnand;
 
 
 // Decrypted NAND device
+#define DNAND_NO_SECTOR  (0xFFFFFFFFu)
+
+// Crypto state of the last access. Back to back accesses on the
+// same partition only advance the counter.
+typedef struct {
+	AES_ctx *ctx;    // NULL = nothing cached
+	u32 partStart;
+	u32 partEnd;
+	u32 nextSector;  // The sector the counter in ctx points to
+	u8 keyslot;
+} dnand_crypt_cache;
+
 typedef struct {
 	dev_struct dev;
 	u32 twlCounter[4];
 	u32 ctrCounter[4];
 	AES_ctx twlAesCtx;
 	AES_ctx ctrAesCtx;
+	dnand_crypt_cache cache;
 } dev_dnand_struct;
 
 bool sdmmc_dnand_init(void);
@@ -91,6 +109,7 @@ bool sdmmc_dnand_read_sector(u32 sector, u32 count, void *buf);
 bool sdmmc_dnand_write_sector(u32 sector, u32 count, const void *buf);
 bool sdmmc_dnand_close(void);
 bool sdmmc_dnand_is_active(void);
+bool sdmmc_dnand_trim_sector(u32 sector, u32 count);
 
 // gcc throws a bullshit warning about missing braces here.
 // Seems to be https://gcc.gnu.org/bugzilla/show_bug.cgi?id=53119
@@ -103,15 +122,28 @@ static dev_dnand_struct dev_dnand = {
 		sdmmc_dnand_write_sector,
 		sdmmc_dnand_close,
 		sdmmc_dnand_is_active,
-		NULL
+		NULL,
+		sdmmc_dnand_trim_sector
 	},
 	{0},
 	{0},
 	{0},
+	{0},
 	{0}
 };
 const dev_struct *dev_decnand = &dev_dnand.dev;
 
+// Sectors per chained transfer. Limited by the AES block counter.
+#define DNAND_MAX_CHAIN_SECTORS  (AES_MAX_BLOCKS>>5)
+
+// NDMA can't reach the TCMs and only does word transfers.
+static inline bool dnandCanChain(const void *buf)
+{
+	const u32 addr = (u32)buf;
+	return !(addr & 3u) && addr >= ITCM_BOOT9_MIRROR + ITCM_SIZE &&
+	       (addr < DTCM_BASE || addr >= DTCM_BASE + DTCM_SIZE);
+}
+
 
 static void sdioHandler(UNUSED u32 id);
 
@@ -145,13 +177,10 @@ bool sdmmc_sd_init(void)
 		dev_sd.initialized = true;
 		IRQ_registerHandler(IRQ_SDIO_1, sdioHandler);
 
+		// Registered NAND drives are mounted again on their next access
 		for(FsDrive i = FS_DRIVE_TWLN; i <= FS_DRIVE_NAND; i++)
 		{
-			if(fIsDriveMounted(i))
-			{
-				fUnmount(i);
-				fMount(i);
-			}
+			if(fUnmount(i) == FR_OK) fMountLazy(i);
 		}
 	}
 
@@ -192,6 +221,15 @@ bool sdmmc_sd_write_sector(u32 sector, u32 count, const void *buf)
 	return !sdmmc_sdcard_writesectors(sector, count, buf);
 }
 
+bool sdmmc_sd_trim_sector(u32 sector, u32 count)
+{
+	if(!dev_sd.initialized) return false;
+
+	fb_assert(count != 0);
+
+	return !sdmmc_sdcard_erasesectors(sector, count);
+}
+
 bool sdmmc_sd_close(void)
 {
 	dev_sd.initialized = false;
@@ -246,6 +284,15 @@ bool sdmmc_rnand_write_sector(u32 sector, u32 count, const void *buf)
 	return !sdmmc_nand_writesectors(sector, count, buf);
 }
 
+bool sdmmc_rnand_trim_sector(u32 sector, u32 count)
+{
+	if(!dev_rnand.initialized) return false;
+
+	fb_assert(count != 0);
+
+	return !sdmmc_nand_trimsectors(sector, count);
+}
+
 bool sdmmc_rnand_close(void)
 {
 	dev_rnand.initialized = false;
@@ -270,6 +317,7 @@ bool sdmmc_dnand_init(void)
 	if(!dev_dnand.dev.initialized)
 	{
 		partitionsReset();
+		dev_dnand.cache.ctx = NULL;
 		if(!dev_rnand.initialized)
 		{
 			if(!sdmmc_rnand_init()) return false;
@@ -350,37 +398,84 @@ bool sdmmc_dnand_init(void)
 	return true;
 }
 
+// Selects the keyslot and sets up the counter for the given sectors.
+// Returns NULL if they are not inside a known partition.
+static AES_ctx* dnandSetupCrypto(u32 sector, u32 count)
+{
+	dnand_crypt_cache *const cache = &dev_dnand.cache;
+
+	if(!cache->ctx || sector < cache->partStart || sector + count > cache->partEnd)
+	{
+		size_t index;
+		partitionStruct part;
+
+		cache->ctx = NULL;
+		if(!partitionFind(sector, count, &index)) return NULL;
+		partitionGetInfo(index, &part);
+		if(part.keyslot == 0xFF) return NULL; // unknown partition type
+
+		cache->partStart = part.sector;
+		cache->partEnd = part.sector + part.count;
+		cache->nextSector = DNAND_NO_SECTOR;
+		cache->keyslot = part.keyslot;
+		cache->ctx = (part.keyslot == 0x03 ? &dev_dnand.twlAesCtx : &dev_dnand.ctrAesCtx);
+	}
+
+	AES_ctx *const ctx = cache->ctx;
+	AES_selectKeyslot(cache->keyslot);
+	if(sector != cache->nextSector)
+	{
+		if(cache->keyslot == 0x03)
+			AES_setCtrIv(ctx, AES_INPUT_LITTLE | AES_INPUT_REVERSED, dev_dnand.twlCounter);
+		else
+			AES_setCtrIv(ctx, AES_INPUT_LITTLE | AES_INPUT_NORMAL, dev_dnand.ctrCounter);
+		AES_addCounter(ctx->ctrIvNonce, sector<<9);
+	}
+	// The crypto functions advance the counter in ctx
+	cache->nextSector = sector + count;
+
+	return ctx;
+}
+
 bool sdmmc_dnand_read_sector(u32 sector, u32 count, void *buf)
 {
 	if(!dev_dnand.dev.initialized) return false;
 
-	size_t index;
-	u8 keyslot;
-
 	fb_assert(count != 0);
 	fb_assert(buf != NULL);
 
-	if(!partitionFind(sector, count, &index)) return false;
-		
-	partitionGetKeyslot(index, &keyslot);
-	if(keyslot == 0xFF) return false; // unknown partition type
+	AES_ctx *const ctx = dnandSetupCrypto(sector, count);
+	if(!ctx) return false;
 
-	AES_ctx *ctx;
-	AES_selectKeyslot(keyslot);
-	if(keyslot == 0x03)
+	if(dnandCanChain(buf))
 	{
-		ctx = &dev_dnand.twlAesCtx;
-		AES_setCtrIv(ctx, AES_INPUT_LITTLE | AES_INPUT_REVERSED, dev_dnand.twlCounter);
-		AES_addCounter(ctx->ctrIvNonce, sector<<9);
+		// Stream sdmmc -> AES -> buf without the ciphertext ever touching RAM
+		flushInvalidateDCacheRange(buf, count<<9);
+		do {
+			const u32 num = min(count, DNAND_MAX_CHAIN_SECTORS);
+
+			AES_ctrFifoStart(ctx, SDMMC_BASE + REG_SDFIFO32, NDMA_STARTUP_MMC1, buf, num<<5, true);
+			const int res = sdmmc_nand_readsectors_dma(sector, num);
+			AES_ctrFifoFinish(res != 0);
+			if(res)
+			{
+				dev_dnand.cache.nextSector = DNAND_NO_SECTOR;
+				return false;
+			}
+
+			sector += num;
+			count -= num;
+			buf += num<<9;
+		} while(count);
+
+		return true;
 	}
-	else
+
+	if(sdmmc_nand_readsectors(sector, count, buf))
 	{
-		ctx = &dev_dnand.ctrAesCtx;
-		AES_setCtrIv(ctx, AES_INPUT_LITTLE | AES_INPUT_NORMAL, dev_dnand.ctrCounter);
-		AES_addCounter(ctx->ctrIvNonce, sector<<9);
+		dev_dnand.cache.nextSector = DNAND_NO_SECTOR;
+		return false;
 	}
-	
-	if(sdmmc_nand_readsectors(sector, count, buf)) return false;
 	flushInvalidateDCacheRange(buf, count<<9);
 	AES_ctr(ctx, buf, buf, count<<5, true);
 
@@ -391,39 +486,45 @@ bool sdmmc_dnand_write_sector(u32 sector, u32 count, const void *buf)
 {
 	if(!dev_dnand.dev.initialized) return false;
 
-	size_t index;
-	u8 keyslot;
-
 	fb_assert(count != 0);
 	fb_assert(buf != NULL);
 
-	if(!partitionFind(sector, count, &index)) return false;
-
-	partitionGetKeyslot(index, &keyslot);
-	if(keyslot == 0xFF) return false; // unknown partition type
-
-	const size_t crypto_sec_size = min(count, 0x1000>>9);
-	void *crypto_buf = malloc(crypto_sec_size<<9);
-	if(!crypto_buf)
-		return false;
+	AES_ctx *const ctx = dnandSetupCrypto(sector, count);
+	if(!ctx) return false;
 
 	flushDCacheRange(buf, count<<9);
 
-	AES_selectKeyslot(keyslot);
-	AES_ctx *ctx;
-	if(keyslot == 0x03)
+	if(dnandCanChain(buf))
 	{
-		ctx = &dev_dnand.twlAesCtx;
-		AES_setCtrIv(ctx, AES_INPUT_LITTLE | AES_INPUT_REVERSED, dev_dnand.twlCounter);
-		AES_addCounter(ctx->ctrIvNonce, sector<<9);
+		// Stream buf -> AES -> sdmmc without a bounce buffer
+		do {
+			const u32 num = min(count, DNAND_MAX_CHAIN_SECTORS);
+
+			AES_ctrFifoStart(ctx, SDMMC_BASE + REG_SDFIFO32, NDMA_STARTUP_MMC1, (u32*)buf, num<<5, false);
+			const int res = sdmmc_nand_writesectors_dma(sector, num);
+			AES_ctrFifoFinish(res != 0);
+			if(res)
+			{
+				dev_dnand.cache.nextSector = DNAND_NO_SECTOR;
+				return false;
+			}
+
+			sector += num;
+			count -= num;
+			buf += num<<9;
+		} while(count);
+
+		return true;
 	}
-	else
+
+	const size_t crypto_sec_size = min(count, 0x1000>>9);
+	void *crypto_buf = malloc(crypto_sec_size<<9);
+	if(!crypto_buf)
 	{
-		ctx = &dev_dnand.ctrAesCtx;
-		AES_setCtrIv(ctx, AES_INPUT_LITTLE | AES_INPUT_NORMAL, dev_dnand.ctrCounter);
-		AES_addCounter(ctx->ctrIvNonce, sector<<9);
+		dev_dnand.cache.nextSector = DNAND_NO_SECTOR;
+		return false;
 	}
-	
+
 	do {
 		size_t crypt_size = min(count, crypto_sec_size);
 
@@ -431,6 +532,7 @@ bool sdmmc_dnand_write_sector(u32 sector, u32 count, const void *buf)
 		AES_ctr(ctx, buf, crypto_buf, crypt_size<<5, true);
 		if(sdmmc_nand_writesectors(sector, crypt_size, crypto_buf))
 		{
+			dev_dnand.cache.nextSector = DNAND_NO_SECTOR;
 			free(crypto_buf);
 			return false;
 		}
@@ -447,6 +549,7 @@ bool sdmmc_dnand_write_sector(u32 sector, u32 count, const void *buf)
 
 bool sdmmc_dnand_close(void)
 {
+	dev_dnand.cache.ctx = NULL;
 	dev_dnand.dev.initialized = false;
 	return true;
 }
@@ -455,3 +558,11 @@ bool sdmmc_dnand_is_active(void)
 {
 	return sdmmc_rnand_is_active() && dev_dnand.dev.initialized;
 }
+
+// Trimmed sectors don't decrypt to anything useful so there is no crypto involved
+bool sdmmc_dnand_trim_sector(u32 sector, u32 count)
+{
+	if(!dev_dnand.dev.initialized) return false;
+
+	return sdmmc_rnand_trim_sector(sector, count);
+}
@@ -27,12 +27,14 @@
 #include "util.h"
 #include "arm9/hardware/crypto.h"
 #include "arm9/hardware/ndma.h"
+#include "hardware/cache.h"
 #include "hardware/pxi.h"
 #include "arm9/partitions.h"
 #include "arm9/dev.h"
 #include "fs.h"
 #include "hardware/gfx.h"
 #include "system.h"
+#include "job.h"
 
 
 typedef struct
@@ -80,7 +82,44 @@ static const FirmWhitelist installWhitelist[] =
 	}
 };
 
+// State of the speculative FIRM load started by prefetchFirm()
+static struct
+{
+	char path[256];
+	JobHandle job;
+	bool valid;      // FIRM_LOAD_ADDR holds the verified FIRM loaded from path
+	bool streaming;  // The job is reading the FIRM in chunks
+	s32 result;
+	u32 modCount;    // fGetModCount() when the prefetch started
+	u32 size;
+	u16 fdate;
+	u16 ftime;
+} firmPrefetch = {.job = -1};
+
 static int firmLaunchArgc;
+// Where firmLaunchStub copies the sections from. RAM FIRMs are launched in place.
+static u32 firmLaunchSrc = FIRM_LOAD_ADDR;
+
+// The warm FIRM cache keeps the last launched FIRM in FCRAM so rebooting
+// into the same boot slot doesn't need to read it again.
+#define FIRM_CACHE_MAGIC  (0x48434D46u) // "FMCH"
+#define FIRM_CACHE_FIRM   (FIRM_CACHE_ADDR + 0x200)
+
+typedef struct
+{
+	u32 magic;
+	u32 firmSize;
+	u32 fileSize;
+	u32 cluster;   // Start cluster of the file
+	u16 fdate;
+	u16 ftime;
+	u32 hash[8];   // SHA 256 over the cached FIRM
+	char path[256];
+} FirmCacheHdr;
+
+static bool firmCacheEnabled;
+// The last FIRM loaded from a file. Written to the cache on launch.
+static FirmCacheHdr firmCachePending;
 
 
 
@@ -120,9 +159,9 @@ bool firm_size(size_t *size, const firm_header *const hdr)
 }
 
 // NOTE: Do not call any functions here!
-void NAKED firmLaunchStub(int argc, const char **argv)
+void NAKED firmLaunchStub(int argc, const char **argv, u32 firmSrc)
 {	
-	firm_header *firm_hdr = (firm_header*)FIRM_LOAD_ADDR;
+	firm_header *firm_hdr = (firm_header*)firmSrc;
 	void (*entry9)(int, const char**, u32) = (void (*)(int, const char**, u32))firm_hdr->entrypointarm9;
 	u32 entry11 = firm_hdr->entrypointarm11;
 
@@ -143,7 +182,7 @@ void NAKED firmLaunchStub(int argc, const char **argv)
 		// Use NDMA for everything but copy method 2
 		if(section->copyMethod < 2)
 		{
-			REG_NDMA_SRC_ADDR(i) = FIRM_LOAD_ADDR + section->offset;
+			REG_NDMA_SRC_ADDR(i) = firmSrc + section->offset;
 			REG_NDMA_DST_ADDR(i) = section->address;
 			REG_NDMA_LOG_BLK_CNT(i) = section->size / 4;
 			REG_NDMA_INT_CNT(i) = NDMA_INT_SYS_FREQ;
@@ -153,7 +192,7 @@ void NAKED firmLaunchStub(int argc, const char **argv)
 		else
 		{
 			u32 *dst = (u32*)section->address;
-			u32 *src = (u32*)(FIRM_LOAD_ADDR + section->offset);
+			u32 *src = (u32*)(firmSrc + section->offset);
 
 			for(u32 n = 0; n < section->size / 4; n += 4)
 			{
@@ -182,63 +221,380 @@ void NAKED firmLaunchStub(int argc, const char **argv)
 	entry9(argc, argv, 0x3BEEFu);
 }
 
-s32 loadVerifyFirm(const char *const path, bool skipHashCheck, bool installMode)
+// FIRM files are read in chunks of this size. The sections are hashed
+// with DMA while the next chunk is read.
+#define FIRM_STREAM_CHUNK  (0x20000)
+
+typedef struct
 {
-	u32 firmSize;
-	firm_header *const firmHdr = (firm_header*)FIRM_LOAD_ADDR;
+	u8 order[4];   // Indices of the streamed sections sorted by offset
+	u8 num;
+	u8 cur;
+	bool started;  // SHA engine is working on section order[cur]
+	u8 doneMask;   // Sections hashed while streaming
+	u8 okMask;     // Sections with matching hash
+	u32 hashPos;   // Next byte to give to the SHA engine
+} FirmStreamHash;
+
+// A FIRM being read to FIRM_LOAD_ADDR from a file or a NAND partition
+typedef struct
+{
+	s32 f;         // File handle. Negative for NAND partitions and once closed.
+	bool isFile;
+	u32 sector;    // Next sector of a NAND partition
+	u32 size;
+	u32 pos;
+	u32 chunkSize;
+	FirmStreamHash *st;
+} FirmStream;
 
 
-	if(memcmp(path, "firm", 4) == 0)
+
+static void streamHashInit(FirmStreamHash *const st, const firm_header *const hdr, u32 firmSize)
+{
+	memset(st, 0, sizeof(FirmStreamHash));
+
+	for(u32 i = 0; i < 4; i++)
 	{
-		if(!dev_decnand->is_active()) return -1;
+		const firm_sectionheader *const section = &hdr->section[i];
+		const u32 offset = section->offset;
 
-		size_t partInd, sector;
-		if(!partitionGetIndex(path, &partInd)) return -2;
-		if(!partitionGetSectorOffset(partInd, &sector)) return -3;
+		// Anything odd is left to the normal checks and hashing
+		if(!section->size || offset & 3u || offset < sizeof(firm_header) ||
+		   offset >= firmSize || section->size > firmSize - offset) continue;
 
-		if(!dev_decnand->read_sector(sector, 1, (void*)FIRM_LOAD_ADDR)) return -4;
-		if(!firm_size((size_t*)&firmSize, firmHdr)) return -5;
-		sector++;
-		if(!dev_decnand->read_sector(sector, (firmSize>>9) - 1, (void*)(FIRM_LOAD_ADDR + sizeof(firm_header))))
-			return -4;
+		u32 pos = st->num++;
+		for(; pos > 0 && hdr->section[st->order[pos - 1]].offset > offset; pos--)
+			st->order[pos] = st->order[pos - 1];
+		st->order[pos] = i;
 	}
-	else if(memcmp(path, "ram", 3) == 0)
+
+	// Overlapping sections can't be hashed in a single pass
+	for(u32 i = 1; i < st->num; i++)
 	{
-		firm_header *const ramBootHdr = (firm_header*)RAM_FIRM_BOOT_ADDR;
-		if(memcmp(&ramBootHdr->magic, "FIRM", 4) == 0)
+		const firm_sectionheader *const prev = &hdr->section[st->order[i - 1]];
+		if(prev->offset + prev->size > hdr->section[st->order[i]].offset) st->num = 0;
+	}
+}
+
+// Hashes as much of the sections as possible with the first avail bytes of the FIRM
+static void streamHashFeed(FirmStreamHash *const st, const firm_header *const hdr, u32 avail)
+{
+	const u8 *const buf = (const u8*)hdr;
+
+	while(st->cur < st->num)
+	{
+		const u32 index = st->order[st->cur];
+		const firm_sectionheader *const section = &hdr->section[index];
+		const u32 secEnd = section->offset + section->size;
+
+		if(avail <= section->offset) break;
+		if(!st->started)
 		{
-			if(!firm_size((size_t*)&firmSize, ramBootHdr)) return -5;
-			NDMA_copy((u32*)FIRM_LOAD_ADDR, (u32*)RAM_FIRM_BOOT_ADDR, firmSize);
-			ramBootHdr->magic = 0;
+			SHA_waitDma();
+			SHA_start(SHA_INPUT_BIG | SHA_MODE_256);
+			st->hashPos = section->offset;
+			st->started = true;
 		}
-		else return -6;
+
+		const u32 end = min(avail, secEnd);
+		const u32 dmaSize = (end - st->hashPos) & ~63u;
+		if(dmaSize)
+		{
+			SHA_waitDma();
+			SHA_updateDmaAsync((const u32*)(buf + st->hashPos), dmaSize);
+			st->hashPos += dmaSize;
+		}
+		if(end < secEnd) break;
+
+		// Section complete
+		u32 hash[8];
+		SHA_waitDma();
+		SHA_update((const u32*)(buf + st->hashPos), secEnd - st->hashPos);
+		SHA_finish(hash, SHA_OUTPUT_BIG);
+		st->doneMask |= 1u<<index;
+		if(memcmp(section->hash, hash, 32) == 0) st->okMask |= 1u<<index;
+
+		st->started = false;
+		st->cur++;
+	}
+}
+
+// Gets the size and modification time for file paths. Zero for partitions.
+static bool firmStat(const char *const path, u32 *size, u16 *fdate, u16 *ftime)
+{
+	*size = 0;
+	*fdate = 0;
+	*ftime = 0;
+	if(memcmp(path, "firm", 4) == 0) return true;
+
+	FsFileInfo fi;
+	if(fStat(path, &fi) != FR_OK) return false;
+	*size = (fi.fsize > 0xFFFFFFFFu ? 0xFFFFFFFFu : fi.fsize);
+	*fdate = fi.fdate;
+	*ftime = fi.ftime;
+
+	return true;
+}
+
+// Identifies a FIRM file by size, modification time and start cluster
+static bool firmCacheIdentify(const char *const path, FirmCacheHdr *const id)
+{
+	if(!firmStat(path, &id->fileSize, &id->fdate, &id->ftime)) return false;
+
+	const s32 f = fOpen(path, FS_OPEN_EXISTING | FS_OPEN_READ);
+	if(f < 0) return false;
+	id->cluster = fGetStartCluster(f);
+	fClose(f);
+
+	return true;
+}
+
+// Checks if the cache holds the unmodified FIRM file at path
+static bool firmCacheLookup(const char *const path, u32 *const firmSize)
+{
+	FirmCacheHdr *const cache = (FirmCacheHdr*)FIRM_CACHE_ADDR;
+
+
+	if(!firmCacheEnabled) return false;
+
+	invalidateDCacheRange(cache, sizeof(FirmCacheHdr));
+	if(cache->magic != FIRM_CACHE_MAGIC) return false;
+	if(cache->firmSize <= sizeof(firm_header) || cache->firmSize > FIRM_MAX_SIZE) return false;
+	if(strncmp(cache->path, path, sizeof(cache->path)) != 0) return false;
+
+	FirmCacheHdr id;
+	if(!firmCacheIdentify(path, &id)) return false;
+	if(id.fileSize != cache->fileSize || id.fdate != cache->fdate ||
+	   id.ftime != cache->ftime || id.cluster != cache->cluster) return false;
+
+	// Whatever ran since the FIRM was cached may have overwritten it
+	const u32 size = cache->firmSize;
+	u32 hash[8];
+	invalidateDCacheRange((void*)FIRM_CACHE_FIRM, size);
+	sha((u32*)FIRM_CACHE_FIRM, size, hash, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+	if(memcmp(hash, cache->hash, 32) != 0)
+	{
+		cache->magic = 0;
+		flushDCacheRange(cache, sizeof(FirmCacheHdr));
+		return false;
+	}
+
+	*firmSize = size;
+
+	return true;
+}
+
+// Checks if any section destination overlaps with the given range
+static bool firmOverlaps(const firm_header *const hdr, u32 addr, u32 size)
+{
+	for(u32 i = 0; i < 4; i++)
+	{
+		const firm_sectionheader *const section = &hdr->section[i];
+		const u32 secAddr = section->address;
+		const u32 secSize = section->size;
+
+		if(!secSize) continue;
+		if(secAddr > ~secSize || (secAddr < addr + size && secAddr + secSize > addr)) return true;
+	}
+
+	return false;
+}
+
+static void firmStreamClose(FirmStream *const stream)
+{
+	if(stream->st) SHA_waitDma();
+	if(stream->f >= 0) fClose(stream->f);
+	stream->f = -1;
+}
+
+// Opens a FIRM file or partition and reads the header to FIRM_LOAD_ADDR.
+// The rest is read by firmStreamStep() in chunks of at most maxChunk bytes.
+// If st is not NULL the sections are hashed on the way.
+static s32 firmStreamOpen(FirmStream *const stream, const char *const path, u32 maxChunk,
+                          FirmStreamHash *const st)
+{
+	u8 *const buf = (u8*)FIRM_LOAD_ADDR;
+	const firm_header *const hdr = (const firm_header*)FIRM_LOAD_ADDR;
+
+
+	memset(stream, 0, sizeof(FirmStream));
+	stream->f = -1;
+	stream->pos = sizeof(firm_header);
+
+	if(memcmp(path, "firm", 4) == 0)
+	{
+		if(!dev_decnand->is_active() && !dev_decnand->init()) return -1;
+
+		size_t partInd, sector;
+		if(!partitionGetIndex(path, &partInd)) return -2;
+		if(!partitionGetSectorOffset(partInd, &sector)) return -3;
+
+		if(!dev_decnand->read_sector(sector, 1, buf)) return -4;
+		size_t firmSize;
+		if(!firm_size(&firmSize, hdr)) return -5;
+		stream->sector = sector + 1;
+		stream->size = firmSize;
+		stream->chunkSize = maxChunk;
 	}
 	else
 	{
-		const s32 f = fOpen(path, FS_OPEN_EXISTING | FS_OPEN_READ);
+		// Contiguous files are read in a single command after the header
+		s32 f = fOpenContiguous(path, FS_OPEN_EXISTING | FS_OPEN_READ);
+		stream->chunkSize = (f >= 0 ? maxChunk : FIRM_STREAM_CHUNK);
+		if(f == FS_ERR_NOT_CONTIGUOUS) f = fOpen(path, FS_OPEN_EXISTING | FS_OPEN_READ);
 		if(f < 0) return -6;
 
-		firmSize = fSize(f);
-		if(firmSize > FIRM_MAX_SIZE)
+		const u64 size = fSize(f);
+		if(size > FIRM_MAX_SIZE)
 		{
 			fClose(f);
 			return -7;
 		}
-		if(fRead(f, (void*)FIRM_LOAD_ADDR, firmSize) < 0)
+		stream->size = size;
+		if(size <= sizeof(firm_header))
+		{
+			fClose(f);
+			return -9;
+		}
+
+		if(fRead(f, buf, sizeof(firm_header)) < 0)
 		{
 			fClose(f);
 			return -8;
 		}
+		stream->f = f;
+		stream->isFile = true;
+	}
+
+	stream->st = st;
+	if(st) streamHashInit(st, hdr, stream->size);
+
+	return 0;
+}
+
+// Reads the next chunk. Returns 1 if there is more to read, 0 when done.
+// The stream is closed when done or on error. The SHA engine may still be
+// busy with the last chunk on return if there is more to read.
+static s32 firmStreamStep(FirmStream *const stream)
+{
+	u8 *const buf = (u8*)FIRM_LOAD_ADDR;
+	const u32 pos = stream->pos;
+
+
+	if(pos < stream->size)
+	{
+		const u32 readSize = min(stream->size - pos, stream->chunkSize);
+		bool ok;
+		if(stream->isFile) ok = fRead(stream->f, buf + pos, readSize) >= 0;
+		else
+		{
+			// NAND FIRMs end on a sector boundary
+			const u32 sectors = readSize>>9;
+			ok = !sectors || dev_decnand->read_sector(stream->sector, sectors, buf + pos);
+			stream->sector += sectors;
+		}
+		if(!ok)
+		{
+			firmStreamClose(stream);
+			return (stream->isFile ? -8 : -4);
+		}
 
-		fClose(f);
+		if(stream->st)
+		{
+			// The SHA engine reads the chunk with DMA
+			flushDCacheRange(buf + pos, readSize);
+			streamHashFeed(stream->st, (const firm_header*)buf, pos + readSize);
+		}
+		stream->pos = pos + readSize;
+		if(stream->pos < stream->size) return 1;
 	}
 
+	firmStreamClose(stream);
+
+	return 0;
+}
+
+// Uses the warm cache if it holds the unmodified FIRM file at path
+static bool useCachedFirm(const char *const path, firm_header **const firmHdr, u32 *const firmSize)
+{
+	if(memcmp(path, "firm", 4) == 0 || !firmCacheLookup(path, firmSize)) return false;
+
+	firm_header *const cacheHdr = (firm_header*)FIRM_CACHE_FIRM;
+	if(!firmOverlaps(cacheHdr, FIRM_CACHE_ADDR, FIRM_CACHE_SIZE)) *firmHdr = cacheHdr;
+	else NDMA_copy((u32*)FIRM_LOAD_ADDR, (u32*)FIRM_CACHE_FIRM, *firmSize);
+
+	return true;
+}
+
+static s32 verifyFirm(const char *const path, firm_header *const firmHdr, u32 firmSize,
+                      bool skipHashCheck, bool installMode, u32 hdrHash[8],
+                      const FirmStreamHash *const streamHash, bool cached);
+
+static s32 loadVerifyFirmInternal(const char *const path, bool skipHashCheck, bool installMode,
+                                  u32 hdrHash[8])
+{
+	u32 firmSize;
+	firm_header *firmHdr = (firm_header*)FIRM_LOAD_ADDR;
+	FirmStreamHash streamHash;
+	bool streamed = false;
+	bool cached = false;
+
+
+	firmCachePending.magic = 0;
+
+	if(memcmp(path, "ram", 3) == 0)
+	{
+		firm_header *const ramBootHdr = (firm_header*)RAM_FIRM_BOOT_ADDR;
+		if(memcmp(&ramBootHdr->magic, "FIRM", 4) == 0)
+		{
+			if(!firm_size((size_t*)&firmSize, ramBootHdr)) return -5;
+			invalidateDCacheRange((void*)RAM_FIRM_BOOT_ADDR, firmSize);
+
+			// Verify and launch the FIRM in place unless a section
+			// would overwrite the image while it's being copied.
+			if(!firmOverlaps(ramBootHdr, RAM_FIRM_BOOT_ADDR, firmSize)) firmHdr = ramBootHdr;
+			else NDMA_copy((u32*)FIRM_LOAD_ADDR, (u32*)RAM_FIRM_BOOT_ADDR, firmSize);
+			ramBootHdr->magic = 0;
+		}
+		else return -6;
+	}
+	else if(!installMode && useCachedFirm(path, &firmHdr, &firmSize))
+	{
+		cached = true;
+	}
+	else
+	{
+		FirmStream stream;
+		s32 res = firmStreamOpen(&stream, path, FIRM_MAX_SIZE, (skipHashCheck ? NULL : &streamHash));
+		if(res < 0) return res;
+		do res = firmStreamStep(&stream); while(res > 0);
+		if(res < 0) return res;
+		firmSize = stream.size;
+		streamed = !skipHashCheck;
+	}
+
+	return verifyFirm(path, firmHdr, firmSize, skipHashCheck, installMode, hdrHash,
+	                  (streamed ? &streamHash : NULL), cached);
+}
+
+// Checks a loaded FIRM and prepares the launch. streamHash holds the
+// section hashes done while reading or is NULL.
+static s32 verifyFirm(const char *const path, firm_header *const firmHdr, u32 firmSize,
+                      bool skipHashCheck, bool installMode, u32 hdrHash[8],
+                      const FirmStreamHash *const streamHash, bool cached)
+{
+	firmCachePending.magic = 0;
 
 	// Check if <= FIRM header size
 	if(firmSize <= sizeof(firm_header)) return -9;
 
-	// Check magic
-	if(memcmp(&firmHdr->magic, "FIRM", 4) != 0) return -10;
+	// The signature covers the first 0x100 bytes of the header
+	if(hdrHash) sha((u32*)firmHdr, 0x100, hdrHash, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+
+	// Check magic. RAM FIRMs verified in place were checked before consuming them.
+	if(firmHdr != (firm_header*)RAM_FIRM_BOOT_ADDR &&
+	   memcmp(&firmHdr->magic, "FIRM", 4) != 0) return -10;
 
 	// ARM9 entrypoint must not be 0
 	if(firmHdr->entrypointarm9 == 0) return -11;
@@ -288,15 +644,31 @@ s32 loadVerifyFirm(const char *const path, bool skipHashCheck, bool installMode)
 		}
 		if(!allowed) return -15;
 
-		if(!skipHashCheck)
+		if(streamHash && (streamHash->doneMask & 1u<<i))
+		{
+			if(!(streamHash->okMask & 1u<<i)) return -16;
+		}
+		else if(!skipHashCheck && !cached) // The cache checks the hash over the whole FIRM
 		{
 			u32 hash[8];
-			sha((u32*)(FIRM_LOAD_ADDR + secOffset), secSize, hash,
+			sha((u32*)((u32)firmHdr + secOffset), secSize, hash,
 			    SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
 			if(memcmp(section->hash, hash, 32) != 0) return -16;
 		}
 	}
 
+	firmLaunchSrc = (u32)firmHdr;
+
+	// Only remember FIRM files with checked hashes for the cache
+	if(firmCacheEnabled && !installMode && !skipHashCheck && !cached &&
+	   memcmp(path, "firm", 4) != 0 && memcmp(path, "ram", 3) != 0 &&
+	   firmCacheIdentify(path, &firmCachePending))
+	{
+		strncpy_s(firmCachePending.path, path, sizeof(firmCachePending.path), sizeof(firmCachePending.path));
+		firmCachePending.firmSize = firmSize;
+		firmCachePending.magic = FIRM_CACHE_MAGIC;
+	}
+
 	strncpy_s((void*)(ITCM_KERNEL_MIRROR + 0x7490), path, 256, 256);
 	((const char**)(ITCM_KERNEL_MIRROR + 0x7470))[0] = ((const char*)(ITCM_KERNEL_MIRROR + 0x7490));
 
@@ -333,13 +705,176 @@ s32 loadVerifyFirm(const char *const path, bool skipHashCheck, bool installMode)
 	}
 }
 
+static FirmStream prefetchStream;
+static FirmStreamHash prefetchHash;
+
+// Loads the FIRM one chunk per run so IPC commands are served in between.
+// Other jobs may use the SHA engine between chunks. This shows up as hash
+// mismatch and loadVerifyFirm() then loads the FIRM again.
+static s32 prefetchJob(UNUSED void *arg)
+{
+	const char *const path = firmPrefetch.path;
+	s32 res;
+
+
+	if(!firmPrefetch.streaming)
+	{
+		if(!firmStat(path, &firmPrefetch.size, &firmPrefetch.fdate, &firmPrefetch.ftime))
+			return -6;
+
+		firm_header *firmHdr = (firm_header*)FIRM_LOAD_ADDR;
+		u32 firmSize;
+		if(useCachedFirm(path, &firmHdr, &firmSize))
+		{
+			res = verifyFirm(path, firmHdr, firmSize, false, false, NULL, NULL, true);
+		}
+		else
+		{
+			res = firmStreamOpen(&prefetchStream, path, FIRM_STREAM_CHUNK, &prefetchHash);
+			if(res == 0)
+			{
+				firmPrefetch.streaming = true;
+				return JOB_AGAIN;
+			}
+		}
+	}
+	else
+	{
+		res = firmStreamStep(&prefetchStream);
+		if(res > 0)
+		{
+			SHA_waitDma();
+			return JOB_AGAIN;
+		}
+		firmPrefetch.streaming = false;
+
+		if(res == 0)
+		{
+			res = verifyFirm(path, (firm_header*)FIRM_LOAD_ADDR, prefetchStream.size,
+			                 false, false, NULL, &prefetchHash, false);
+		}
+	}
+
+	firmPrefetch.result = res;
+	firmPrefetch.valid = res >= 0;
+
+	return res;
+}
+
+// Finishes or cancels a pending prefetch job
+static void prefetchReap(bool wait)
+{
+	if(firmPrefetch.job < 0) return;
+
+	if(wait) JOB_wait(firmPrefetch.job);
+	else if(JOB_cancel(firmPrefetch.job) && firmPrefetch.streaming)
+	{
+		firmStreamClose(&prefetchStream);
+		firmPrefetch.streaming = false;
+	}
+	JOB_release(firmPrefetch.job);
+	firmPrefetch.job = -1;
+}
+
+s32 prefetchFirm(const char *const path)
+{
+	// RAM FIRMs are consumed on load
+	if(memcmp(path, "ram", 3) == 0) return -1;
+
+	prefetchReap(false);
+	firmPrefetch.valid = false;
+	firmPrefetch.modCount = fGetModCount();
+	strncpy_s(firmPrefetch.path, path, sizeof(firmPrefetch.path), sizeof(firmPrefetch.path));
+
+	const JobHandle job = JOB_post(JOB_PRIO_LOW, prefetchJob, NULL, false);
+	if(job < 0) return -2;
+	firmPrefetch.job = job;
+
+	return 0;
+}
+
+void invalidatePrefetchedFirm(void)
+{
+	prefetchReap(false);
+	firmPrefetch.valid = false;
+}
+
+s32 enableFirmCache(bool enable)
+{
+	if(firmCacheEnabled && !enable)
+	{
+		FirmCacheHdr *const cache = (FirmCacheHdr*)FIRM_CACHE_ADDR;
+		cache->magic = 0;
+		flushDCacheRange(cache, sizeof(FirmCacheHdr));
+	}
+	firmCacheEnabled = enable;
+
+	return 0;
+}
+
+// Copies the FIRM about to be launched to the cache
+static void firmCacheStore(void)
+{
+	FirmCacheHdr *const cache = (FirmCacheHdr*)FIRM_CACHE_ADDR;
+
+
+	if(!firmCacheEnabled || firmCachePending.magic != FIRM_CACHE_MAGIC) return;
+
+	// No point in caching a FIRM that overwrites the cache on launch
+	if(firmOverlaps((firm_header*)firmLaunchSrc, FIRM_CACHE_ADDR, FIRM_CACHE_SIZE)) return;
+
+	const u32 size = firmCachePending.firmSize;
+	NDMA_copy((u32*)FIRM_CACHE_FIRM, (u32*)firmLaunchSrc, size);
+	sha((u32*)firmLaunchSrc, size, firmCachePending.hash, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+
+	memcpy(cache, &firmCachePending, sizeof(FirmCacheHdr));
+	flushDCacheRange(cache, sizeof(FirmCacheHdr));
+}
+
+s32 loadVerifyFirm(const char *const path, bool skipHashCheck, bool installMode)
+{
+	const bool samePath = !installMode &&
+	                      strncmp(path, firmPrefetch.path, sizeof(firmPrefetch.path)) == 0;
+
+	prefetchReap(samePath);
+
+	// Cache hit if nothing was written since the prefetch started. File
+	// times can't tell (FF_FS_NORTC) and firmN partitions have none.
+	// The prefetch always checks the hashes so skipHashCheck doesn't matter.
+	if(samePath && firmPrefetch.valid && firmPrefetch.modCount == fGetModCount())
+	{
+		u32 size;
+		u16 fdate, ftime;
+		if(firmStat(path, &size, &fdate, &ftime) && size == firmPrefetch.size &&
+		   fdate == firmPrefetch.fdate && ftime == firmPrefetch.ftime)
+		{
+			return firmPrefetch.result;
+		}
+	}
+
+	// Anything else overwrites the FIRM buffer
+	firmPrefetch.valid = false;
+
+	return loadVerifyFirmInternal(path, skipHashCheck, installMode, NULL);
+}
+
+s32 loadVerifyFirmHashHeader(const char *const path, u32 hdrHash[8])
+{
+	prefetchReap(false);
+	firmPrefetch.valid = false;
+
+	return loadVerifyFirmInternal(path, false, true, hdrHash);
+}
+
 noreturn void firmLaunch(void)
 {
+	firmCacheStore();
 	memcpy((void*)A9_STUB_ENTRY, (const void*)firmLaunchStub, A9_STUB_SIZE);
 
 	__systemDeinit();
 	deinitCpu();
 
-	((void (*)(int, const char**))A9_STUB_ENTRY)(firmLaunchArgc, (const char**)(ITCM_KERNEL_MIRROR + 0x7470));
+	((void (*)(int, const char**, u32))A9_STUB_ENTRY)(firmLaunchArgc, (const char**)(ITCM_KERNEL_MIRROR + 0x7470),
+	                                                  firmLaunchSrc);
 	while(1);
 }
@@ -99,7 +99,7 @@ alignas(4) static const u8 fastboot3DS_pubkey[256] =
 s32 writeFirmPartition(const char *const part, bool replaceSig)
 {
 	if(memcmp(part, "firm", 4) != 0) return -1;
-	if(!dev_decnand->is_active()) return -2;
+	if(!dev_decnand->is_active() && !dev_decnand->init()) return -2;
 
 	size_t partInd, sector;
 	if(!partitionGetIndex(part, &partInd)) return -3;
@@ -108,6 +108,9 @@ s32 writeFirmPartition(const char *const part, bool replaceSig)
 	size_t firmSize;
 	if(!firm_size(&firmSize, (firm_header*)FIRM_LOAD_ADDR)) return -5;
 
+	// The FIRM buffer and maybe the prefetched partition are modified below
+	invalidatePrefetchedFirm();
+
 	u8 *firmBuf = (u8*)FIRM_LOAD_ADDR;
 	if(replaceSig)
 		memcpy(firmBuf + 0x100, sighaxNandSigs[REG_CFG9_UNITINFO != 0], 0x100);
@@ -143,15 +146,19 @@ s32 writeFirmPartition(const char *const part, bool replaceSig)
 
 s32 loadVerifyUpdate(const char *const path, u32 *const version)
 {
-	if(!dev_decnand->is_active()) return -1;
-	if(loadVerifyFirm(path, false, true) < 0) return UPDATE_ERR_INVALID_FIRM;
+	if(!dev_decnand->is_active() && !dev_decnand->init()) return -1;
+	// Loads, hashes the sections and the signed header in one pass
+	u32 hdrHash[8];
+	if(loadVerifyFirmHashHeader(path, hdrHash) < 0) return UPDATE_ERR_INVALID_FIRM;
 
 	u32 *updateBuffer = (u32*)FIRM_LOAD_ADDR;
 #ifdef NDEBUG
 	// Verify signature
 	if(!RSA_setKey2048(3, (u32*)fastboot3DS_pubkey, 0x01000100) ||
-	   !RSA_verify2048(updateBuffer + 0x40, updateBuffer, 0x100))
+	   !RSA_verify2048Hash(updateBuffer + 0x40, hdrHash))
 		return UPDATE_ERR_INVALID_SIG;
+#else
+	(void)hdrHash;
 #endif
 
 	// verify fastboot magic
@@ -190,7 +197,7 @@ s32 loadVerifyUpdate(const char *const path, u32 *const version)
 
 s32 toggleSuperhax(bool enable)
 {
-	if(!dev_decnand->is_active()) return -1;
+	if(!dev_decnand->is_active() && !dev_decnand->init()) return -1;
 
 	size_t partInd, sector;
 	if(!partitionGetIndex("firm0", &partInd)) return -2;
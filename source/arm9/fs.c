@@ -20,12 +20,17 @@
 #include <malloc.h>
 #include "types.h"
 #include "util.h"
+#include "mem_map.h"
 #include "fs.h"
+#include "job.h"
 #include "arm9/debug.h"
+#include "arm9/hardware/cfg9.h"
 #include "arm9/dev.h"
 #include "arm9/ncsd.h"
 #include "arm9/partitions.h"
+#include "arm9/firm.h"
 #include "fatfs/ff.h"
+#include "fatfs/diskio.h"
 
 
 typedef struct
@@ -44,17 +49,85 @@ typedef struct
 
 static const DevHandle devHandleMagic = 0x42424296;
 
+#define FS_CONTIG_UNKNOWN  (0u)
+#define FS_CONTIG_NONE     (0xFFFFFFFFu)
+
+// FIL flags internal to ff.c
+#define FS_FIL_MODIFIED    (0x40u)
+#define FS_FIL_DIRTY       (0x80u)
+
 static FATFS fsTable[FS_MAX_DRIVES] = {0};
 static const char *const fsPathTable[FS_MAX_DRIVES] = {FS_DRIVE_NAMES};
 static bool fsStatTable[FS_MAX_DRIVES] = {0};
 
-static FIL fTable[FS_MAX_FILES] = {0};
-static bool fStatTable[FS_MAX_FILES] = {0};
-static u32 fHandles = 0;
+// Handles are (generation<<16 | slot). The generation of a slot is odd
+// while it is in use and advances on every open and close so a handle
+// of a closed file or dir is rejected even after its slot got reused.
+#define HANDLE_SLOT(h)    ((u32)(h) & 0xFFFFu)
+#define HANDLE_GEN(h)     ((u32)(h)>>16)
+#define HANDLE_GEN_MASK   (0x7FFFu)
+#define HANDLE_SLOT_NONE  (0xFFFFu)
+
+typedef struct
+{
+	u16 *const gen;
+	u16 *const next;     // Free list links
+	const u16 capacity;
+	u16 freeHead;
+	bool initialized;
+} HandleSlab;
+
+// The FILs carry the FatFs per-file sector buffers (FF_FS_TINY 0)
+// so they form their own pool separate from the slab bookkeeping.
+static FIL fPool[FS_MAX_FILES] = {0};
+static u32 fContigTable[FS_MAX_FILES] = {0}; // First sector if the file is contiguous
+static u16 fGenTable[FS_MAX_FILES] = {0};
+static u16 fNextTable[FS_MAX_FILES];
+static HandleSlab fSlab = {fGenTable, fNextTable, FS_MAX_FILES, HANDLE_SLOT_NONE, false};
+
+// Bumped by every call that may allocate or free clusters or change file contents
+static u32 fsModCount = 0;
+
+static DIR dPool[FS_MAX_DIRS] = {0};
+static u16 dGenTable[FS_MAX_DIRS] = {0};
+static u16 dNextTable[FS_MAX_DIRS];
+static HandleSlab dSlab = {dGenTable, dNextTable, FS_MAX_DIRS, HANDLE_SLOT_NONE, false};
+
+#ifndef FS_FAT_CACHE_LINES
+#define FS_FAT_CACHE_LINES         (4) // Per mounted volume
+#endif
+#define FS_FAT_CACHE_LINE_SECTORS  (8) // Read with one disk command
+
+// Write-through cache for the FAT and exFAT bitmap sectors passing
+// through the FatFs window. A miss loads a whole line so chain walks and
+// f_getfree() need a fraction of the reads (and on NAND decrypts). Going
+// back and forth between FAT and dir sectors no longer rereads the FAT.
+typedef struct
+{
+	DWORD base; // First sector. 0 = unused, sector 0 is never in the FAT.
+	u32 num;    // Sectors in the line. Lines end at the table end.
+	u32 ref;    // Clock reference bit
+} FatCacheLine;
 
-static DIR dTable[FS_MAX_DIRS] = {0};
-static bool dStatTable[FS_MAX_DIRS] = {0};
-static u32 dHandles = 0;
+typedef struct
+{
+	u8 *buf;    // Allocated on first use
+	FatCacheLine lines[FS_FAT_CACHE_LINES];
+	u32 hand;
+	WORD fsId;  // Mount ID the lines belong to
+} FatCache;
+
+static FatCache fatCacheTable[FS_MAX_DRIVES] = {0};
+
+// The ARM9 heap is the A9 RAM above the image, FIL and DIR pools included.
+// A NAND backup allocates the biggest device buffer while all disk and FAT
+// caches may be in use. New 3DS has 512 KiB more RAM for its bigger buffer.
+#define FS_FAT_CACHE_HEAP_SIZE  (FS_MAX_DRIVES * FS_FAT_CACHE_LINES * FS_FAT_CACHE_LINE_SECTORS * 512)
+#define FS_HEAP_RESERVE         (0x4000) // Small buffers and malloc overhead
+_Static_assert(DISK_HEAP_SIZE + FS_FAT_CACHE_HEAP_SIZE + FS_DEVBUF_SIZE_O3DS + FS_HEAP_RESERVE <=
+               A9_RAM_SIZE - A9_IMAGE_MAX_SIZE, "FS caches leave no room for the device buffer");
+_Static_assert(FS_DEVBUF_SIZE_N3DS - FS_DEVBUF_SIZE_O3DS <= A9_RAM_N3DS_EXT_SIZE,
+               "New 3DS device buffer too big");
 
 static bool devStatTable[FS_MAX_DEVICES] = {0};
 static bool fsStatBackupTable[FS_MAX_DRIVES] = {0};
@@ -67,6 +140,14 @@ static size_t numProtNandRegions;
 
 
 static bool isFileHandleValid(s32 handle);
+static void freeScanStart(FsDrive drive);
+static void freeScanStop(FsDrive drive);
+static void syncFsInfo(FATFS *const fs);
+
+static inline FIL* getFile(s32 handle)
+{
+	return &fPool[HANDLE_SLOT(handle)];
+}
 
 static inline bool isNandProtected()
 {
@@ -98,13 +179,154 @@ static inline ProtNandRegion *getNandProtRegion(size_t startSector, size_t write
 	return NULL;
 }
 
+bool fIsNandRangeProtected(u32 sector, u32 count)
+{
+	return getNandProtRegion(sector, count) != NULL;
+}
+
+// Returns the size of the table containing the sector and its start in *tableStart. 0 if none.
+static u32 getFatCacheTable(const FATFS *const fs, DWORD sector, DWORD *tableStart)
+{
+	if(sector - fs->fatbase < fs->fsize) // 1st FAT
+	{
+		*tableStart = fs->fatbase;
+		return fs->fsize;
+	}
+
+	const u32 bitmapSectors = (fs->n_fatent - 2 + 4095) / 4096;
+	if(fs->fs_type == FS_EXFAT && sector - fs->bitbase < bitmapSectors)
+	{
+		*tableStart = fs->bitbase;
+		return bitmapSectors;
+	}
+
+	return 0;
+}
+
+static FatCache* getFatCache(const FATFS *const fs)
+{
+	// Not mounted yet or not one of ours
+	if(fs->fs_type == 0 || fs < fsTable || fs >= &fsTable[FS_MAX_DRIVES]) return NULL;
+
+	FatCache *const cache = &fatCacheTable[fs - fsTable];
+	if(!cache->buf)
+	{
+		cache->buf = (u8*)malloc(FS_FAT_CACHE_LINES * FS_FAT_CACHE_LINE_SECTORS * 512);
+		if(!cache->buf) return NULL;
+		cache->fsId = fs->id - 1; // Force a reset below
+	}
+	if(cache->fsId != fs->id)
+	{
+		memset(cache->lines, 0, sizeof(cache->lines));
+		cache->hand = 0;
+		cache->fsId = fs->id;
+	}
+
+	return cache;
+}
+
+static FatCacheLine* findFatCacheLine(FatCache *const cache, DWORD sector)
+{
+	for(u32 i = 0; i < FS_FAT_CACHE_LINES; i++)
+	{
+		FatCacheLine *const line = &cache->lines[i];
+		if(line->base && sector - line->base < line->num) return line;
+	}
+
+	return NULL;
+}
+
+static u8* getFatCacheSector(FatCache *const cache, const FatCacheLine *const line, DWORD sector)
+{
+	return &cache->buf[((line - cache->lines) * FS_FAT_CACHE_LINE_SECTORS + (sector - line->base)) * 512];
+}
+
+static void freeFatCache(FsDrive drive)
+{
+	FatCache *const cache = &fatCacheTable[drive];
+	free(cache->buf);
+	cache->buf = NULL;
+}
+
+// FatFs hook. Called from move_window() with the volume locked and the window clean.
+int ff_fatcache_read(FATFS *fs, BYTE *buff, DWORD sector)
+{
+	DWORD tableStart;
+	const u32 tableSize = getFatCacheTable(fs, sector, &tableStart);
+	if(!tableSize) return 0;
+
+	FatCache *const cache = getFatCache(fs);
+	if(!cache) return 0;
+
+	FatCacheLine *line = findFatCacheLine(cache, sector);
+	if(!line)
+	{
+		// Clock replacement. Skip and clear referenced lines.
+		while(cache->lines[cache->hand].ref)
+		{
+			cache->lines[cache->hand].ref = 0;
+			cache->hand = (cache->hand + 1) % FS_FAT_CACHE_LINES;
+		}
+		line = &cache->lines[cache->hand];
+		cache->hand = (cache->hand + 1) % FS_FAT_CACHE_LINES;
+
+		const DWORD base = tableStart + ((sector - tableStart) & ~(FS_FAT_CACHE_LINE_SECTORS - 1u));
+		const u32 num = min(FS_FAT_CACHE_LINE_SECTORS, tableStart + tableSize - base);
+		line->base = base;
+		line->num = num;
+		if(disk_read(fs->pdrv, getFatCacheSector(cache, line, base), base, num) != RES_OK)
+		{
+			line->base = 0;
+			return 0;
+		}
+	}
+
+	memcpy(buff, getFatCacheSector(cache, line, sector), 512);
+	line->ref = 1;
+
+	return 1;
+}
+
+// FatFs hook. Called after a window sector was read from or written to the disk.
+void ff_fatcache_write(FATFS *fs, const BYTE *buff, DWORD sector)
+{
+	DWORD tableStart;
+	if(!getFatCacheTable(fs, sector, &tableStart)) return;
+
+	FatCache *const cache = getFatCache(fs);
+	if(!cache) return;
+
+	const FatCacheLine *const line = findFatCacheLine(cache, sector);
+	if(line) memcpy(getFatCacheSector(cache, line, sector), buff, 512);
+}
+
+// fsStatTable[] tracks registered drives. A drive registered by
+// fMountLazy() is only mounted once FatFs set fs_type.
 s32 fMount(FsDrive drive)
 {
 	if((u32)drive >= FS_MAX_DRIVES) return -30;
-	if(fsStatTable[drive]) return -31;
+	// Lazily registered drives that were not accessed yet are mounted now
+	if(fsStatTable[drive] && fsTable[drive].fs_type != 0) return -31;
 
 	FRESULT res = f_mount(&fsTable[drive], fsPathTable[drive], 1);
 	if(res == FR_OK)
+	{
+		fsStatTable[drive] = true;
+		freeScanStart(drive);
+		return FR_OK;
+	}
+	else return -res;
+}
+
+// Registers the drive without touching the device. FatFs mounts it
+// on the first access to a path on it.
+s32 fMountLazy(FsDrive drive)
+{
+	if((u32)drive >= FS_MAX_DRIVES) return -30;
+	if(fsStatTable[drive]) return -31;
+
+	FRESULT res = f_mount(&fsTable[drive], fsPathTable[drive], 0);
+	if(res == FR_OK)
 	{
 		fsStatTable[drive] = true;
 		return FR_OK;
@@ -117,8 +339,15 @@ s32 fUnmount(FsDrive drive)
 	if((u32)drive >= FS_MAX_DRIVES) return -30;
 	if(!fsStatTable[drive]) return -31;
 
+	// FatFs doesn't sync on unmount. Write back FSInfo and the sector cache.
+	freeScanStop(drive);
+	syncFsInfo(&fsTable[drive]);
+	disk_ioctl(VolToPart[drive].pd, CTRL_SYNC, NULL);
+
 	FRESULT res = f_mount(NULL, fsPathTable[drive], 0);
 	fsStatTable[drive] = false;
+	freeFatCache(drive);
+	fsModCount++; // A different card may get mounted
 
 	if(res == FR_OK) return FR_OK;
 	else return -res;
@@ -126,14 +355,15 @@ s32 fUnmount(FsDrive drive)
 
 bool fIsDriveMounted(FsDrive drive)
 {
-	if((u32)drive >= FS_MAX_DRIVES) return false;
+	if((u32)drive >= FS_MAX_DRIVES || !fsStatTable[drive]) return false;
 	
-	return fsStatTable[drive];
+	// Probe lazily registered drives instead of reporting them as mounted
+	return fsTable[drive].fs_type != 0 || fMount(drive) == FR_OK;
 }
 
 static s32 ensureUnmounted(FsDrive drive)
 {
-	if(!fIsDriveMounted(drive))
+	if(!fsStatTable[drive])
 		return FR_OK;
 	
 	return fUnmount(drive);
@@ -141,10 +371,265 @@ static s32 ensureUnmounted(FsDrive drive)
 
 static s32 ensureMounted(FsDrive drive)
 {
-	if(fIsDriveMounted(drive))
+	if(fsStatTable[drive])
 		return FR_OK;
 	
-	return fMount(drive);
+	return fMountLazy(drive);
+}
+
+// The NAND drives are mounted lazily so the device may not be up yet
+static bool initNandDevice(void)
+{
+	return dev_decnand->is_active() || dev_decnand->init();
+}
+
+#define FS_TABLE_BUF_SECTORS  (16)
+#define FS_FREE_SCAN_CHUNK    (8192u) // Clusters per background job run
+
+typedef struct
+{
+	u8 *buf;
+	u32 start; // First buffered table sector
+	u32 num;   // 0 = nothing buffered
+} FatTableBuf;
+
+typedef struct
+{
+	JobHandle job; // 0 = no scan
+	u32 clst;      // Next cluster to look at
+	u32 numFree;
+	u32 modCount;  // fsModCount when the scan (re)started
+	WORD fsId;     // Mount ID of the scanned volume
+	FatTableBuf tbl;
+} FreeScan;
+
+static FreeScan freeScanTable[FS_MAX_DRIVES] = {0};
+
+// Looks up a cluster in the FAT or the exFAT allocation bitmap.
+// Returns 1 for free, 0 for used and a negative error code on read errors.
+static s32 isClusterFree(const FATFS *fs, FatTableBuf *tbl, u32 clst)
+{
+	u32 base, tableSectors, byteOffset;
+	switch(fs->fs_type)
+	{
+		case FS_FAT16:
+			base = fs->fatbase;
+			tableSectors = fs->fsize;
+			byteOffset = clst * 2;
+			break;
+		case FS_FAT32:
+			base = fs->fatbase;
+			tableSectors = fs->fsize;
+			byteOffset = clst * 4;
+			break;
+		default: // FS_EXFAT
+			base = fs->bitbase;
+			tableSectors = (fs->n_fatent - 2 + 4095) / 4096;
+			byteOffset = (clst - 2) / 8;
+	}
+
+	const u32 sector = byteOffset / 512;
+	if(!tbl->num || sector < tbl->start || sector >= tbl->start + tbl->num)
+	{
+		const u32 num = min(FS_TABLE_BUF_SECTORS, tableSectors - sector);
+		tbl->num = 0;
+		if(disk_read(fs->pdrv, tbl->buf, base + sector, num) != RES_OK) return -FR_DISK_ERR;
+
+		// The FatFs window may hold a newer copy of a table sector
+		if(fs->winsect >= base + sector && fs->winsect < base + sector + num)
+			memcpy(&tbl->buf[(fs->winsect - base - sector) * 512], fs->win, 512);
+		tbl->start = sector;
+		tbl->num = num;
+	}
+
+	const u8 *const entry = &tbl->buf[byteOffset - tbl->start * 512];
+	switch(fs->fs_type)
+	{
+		case FS_FAT16:
+			return *(const u16*)entry == 0;
+		case FS_FAT32:
+			return (*(const u32*)entry & 0x0FFFFFFFu) == 0;
+		default:
+			return !(*entry & 1u<<((clst - 2) % 8));
+	}
+}
+
+// Trims every run of free clusters on the drive. Returns the discarded size in MiB.
+s32 fDiscardFreeSpace(FsDrive drive)
+{
+	if((u32)drive >= FS_MAX_DRIVES) return -30;
+	if(!fsStatTable[drive]) return -31;
+
+	// Allocations of open files may only be in the FatFs window
+	FATFS *const fs = &fsTable[drive];
+	for(u32 i = 0; i < FS_MAX_FILES; i++)
+	{
+		if(fGenTable[i] & 1u && fPool[i].obj.fs == fs) return -31;
+	}
+
+	// Mounts the drive if needed
+	DWORD freeClusters;
+	FATFS *tmp;
+	FRESULT res = f_getfree(fsPathTable[drive], &freeClusters, &tmp);
+	if(res != FR_OK) return -res;
+
+	if(fs->fs_type == FS_FAT12) return FS_ERR_UNSUPPORTED;
+
+	FatTableBuf tbl = {(u8*)malloc(FS_TABLE_BUF_SECTORS<<9), 0, 0};
+	if(!tbl.buf) return -31;
+
+	// Entry 0 and 1 are reserved
+	u32 runStart = 0; // 0 = not in a free run
+	u32 discarded = 0;
+	s32 err = FR_OK;
+	for(u32 clst = 2; clst <= fs->n_fatent; clst++)
+	{
+		s32 isFree = 0;
+		if(clst < fs->n_fatent)
+		{
+			isFree = isClusterFree(fs, &tbl, clst);
+			if(isFree < 0)
+			{
+				err = isFree;
+				break;
+			}
+		}
+
+		if(isFree && !runStart) runStart = clst;
+		else if(!isFree && runStart)
+		{
+			DWORD range[2];
+			range[0] = fs->database + (runStart - 2) * fs->csize;
+			range[1] = fs->database + (clst - 2) * fs->csize - 1;
+			if(disk_ioctl(fs->pdrv, CTRL_TRIM, range) != RES_OK)
+			{
+				err = -FR_DISK_ERR;
+				break;
+			}
+
+			discarded += clst - runStart;
+			runStart = 0;
+		}
+	}
+
+	free(tbl.buf);
+	if(err != FR_OK) return err;
+
+	return ((u64)discarded * fs->csize)>>11;
+}
+
+static inline bool isFreeCountValid(const FATFS *const fs)
+{
+	return fs->free_clst <= fs->n_fatent - 2;
+}
+
+// Counts the free clusters in chunks as a low priority job. FatFs keeps
+// the count up to date on allocation and free once it is valid.
+static s32 freeScanJob(void *arg)
+{
+	const FsDrive drive = (FsDrive)arg;
+	FreeScan *const scan = &freeScanTable[drive];
+	FATFS *const fs = &fsTable[drive];
+
+
+	// Remounted or f_getfree() already counted
+	s32 res = FR_OK;
+	if(fs->fs_type == 0 || fs->id != scan->fsId || isFreeCountValid(fs)) goto end;
+
+	// Clusters may have changed behind the scan position. Start over.
+	if(scan->modCount != fsModCount)
+	{
+		scan->clst = 2;
+		scan->numFree = 0;
+		scan->modCount = fsModCount;
+		scan->tbl.num = 0;
+	}
+
+	u32 clst = scan->clst;
+	const u32 end = (fs->n_fatent - clst > FS_FREE_SCAN_CHUNK ? clst + FS_FREE_SCAN_CHUNK : fs->n_fatent);
+	for(; clst < end; clst++)
+	{
+		res = isClusterFree(fs, &scan->tbl, clst);
+		if(res < 0) break;
+		scan->numFree += res;
+	}
+	if(res >= 0 && clst == fs->n_fatent)
+	{
+		fs->free_clst = scan->numFree;
+		fs->fsi_flag |= 1; // FAT32: FSInfo is to be updated
+	}
+	if(res < 0) goto end;
+
+	scan->clst = clst;
+	JOB_setProgress(clst - 2, fs->n_fatent - 2);
+	if(clst < fs->n_fatent) return JOB_AGAIN;
+	res = FR_OK;
+
+end:
+	free(scan->tbl.buf);
+	scan->tbl.buf = NULL;
+
+	return res;
+}
+
+// Only for FAT32 volumes without a valid FSInfo free count. FatFs loads a
+// valid one on mount. FAT16 FATs and exFAT bitmaps are small enough for
+// f_getfree() to count on demand.
+static void freeScanStart(FsDrive drive)
+{
+	FATFS *const fs = &fsTable[drive];
+	FreeScan *const scan = &freeScanTable[drive];
+
+	if(scan->job || fs->fs_type != FS_FAT32 || isFreeCountValid(fs)) return;
+
+	scan->tbl.buf = (u8*)malloc(FS_TABLE_BUF_SECTORS<<9);
+	if(!scan->tbl.buf) return;
+	scan->tbl.num = 0;
+	scan->clst = 2;
+	scan->numFree = 0;
+	scan->modCount = fsModCount;
+	scan->fsId = fs->id;
+
+	const JobHandle job = JOB_post(JOB_PRIO_LOW, freeScanJob, (void*)drive, false);
+	if(job < 0)
+	{
+		free(scan->tbl.buf);
+		scan->tbl.buf = NULL;
+		return;
+	}
+	scan->job = job;
+}
+
+static void freeScanStop(FsDrive drive)
+{
+	FreeScan *const scan = &freeScanTable[drive];
+	if(!scan->job) return;
+
+	JOB_cancel(scan->job);
+	JOB_release(scan->job);
+	scan->job = 0;
+	free(scan->tbl.buf);
+	scan->tbl.buf = NULL;
+}
+
+// FatFs only writes FSInfo when syncing after a change so a
+// count from the scan or f_getfree() would be lost on unmount.
+static void syncFsInfo(FATFS *const fs)
+{
+	if(fs->fs_type != FS_FAT32 || fs->fsi_flag != 1) return;
+
+	u32 *const fsi = (u32*)malloc(512);
+	if(!fsi) return;
+
+	memset(fsi, 0, 512);
+	fsi[0] = 0x41615252;   // Lead signature
+	fsi[121] = 0x61417272; // Struct signature
+	fsi[122] = fs->free_clst;
+	fsi[123] = fs->last_clst;
+	fsi[127] = 0xAA550000; // Trail signature
+	if(disk_write(fs->pdrv, (const BYTE*)fsi, fs->volbase + 1, 1) == RES_OK) fs->fsi_flag = 0;
+
+	free(fsi);
 }
 
 s32 fGetFree(FsDrive drive, u64 *size)
@@ -152,12 +637,19 @@ s32 fGetFree(FsDrive drive, u64 *size)
 	if((u32)drive >= FS_MAX_DRIVES) return -30;
 	if(!fsStatTable[drive]) return -31;
 
+	// Finish a pending background scan. It continues where it left off.
+	if(freeScanTable[drive].job)
+	{
+		JOB_wait(freeScanTable[drive].job);
+		freeScanStop(drive);
+	}
+
 	DWORD freeClusters;
 	FATFS *fs;
 	FRESULT res = f_getfree(fsPathTable[drive], &freeClusters, &fs);
 	if(res == FR_OK)
 	{
-		if(size) *size = ((u64)(freeClusters * fs->csize)) * 512;
+		if(size) *size = (u64)freeClusters * fs->csize * 512;
 		return FR_OK;
 	}
 	else return -res;
@@ -171,6 +663,7 @@ u32 fGetDeviceSize(FsDevice dev)
 			return dev_sdcard->get_sector_count();
 			break;
 		case FS_DEVICE_NAND:
+			if(!initNandDevice()) return 0;
 			return dev_rawnand->get_sector_count();
 			break;
 		default:
@@ -207,6 +700,9 @@ s32 fPrepareRawAccess(FsDevice dev)
 	if(dev != FS_DEVICE_NAND)
 		return -31;
 	
+	if(!initNandDevice())
+		return -31;
+	
 	memcpy(fsStatBackupTable, fsStatTable, sizeof(fsStatTable));
 	
 	switch(dev)
@@ -222,6 +718,12 @@ s32 fPrepareRawAccess(FsDevice dev)
 			if(err != FR_OK) return err;
 			err = ensureUnmounted(FS_DRIVE_NAND);
 			if(err != FR_OK) return err;
+			// Raw writes may replace the firmN partitions and everything else
+			invalidatePrefetchedFirm();
+			fsModCount++;
+			// Raw writes don't go through the sector cache
+			disk_ioctl(FATFS_DEV_NUM_TWL_NAND, DISK_CACHE_INVALIDATE, NULL);
+			disk_ioctl(FATFS_DEV_NUM_CTR_NAND, DISK_CACHE_INVALIDATE, NULL);
 			break;
 		default:
 			return -30; //panic();
@@ -294,7 +796,8 @@ static bool devBufAllocate(DevBuf *devBuf, u32 size)
 
 s32 fCreateDeviceBuffer(u32 size)
 {
-	if(!size || size > 0x180000) return -30;
+	const u32 maxSize = ((REG_CFG9_SOCINFO & 2) ? FS_DEVBUF_SIZE_N3DS : FS_DEVBUF_SIZE_O3DS);
+	if(!size || size > maxSize) return -30;
 	if(devBuf.mem) return -31;
 	
 	if(!devBufAllocate(&devBuf, size))
@@ -405,6 +908,62 @@ s32 fReadToDeviceBuffer(s32 sourceHandle, u32 sourceOffset, u32 sourceSize, DevB
 	return FR_OK;
 }
 
+// Writes sectors to raw NAND skipping protected regions
+static bool rawNandWrite(u32 sector, u32 count, const u8 *buf)
+{
+	const ProtNandRegion *region;
+	
+	if(isNandProtected())
+	{
+		u32 toWrite = count;
+		const u8 *devBufPtr = buf;
+		
+		/* check if we want to write to a protected area on NAND */
+		
+		do
+		{
+			region = getNandProtRegion(sector, toWrite);
+			
+			if(region)
+			{
+				// we're inside a prot region?
+				if(region->sector <= sector)
+				{
+					// calc how much do we need to skip
+					count = min(region->sector + region->count, sector + toWrite) - sector;
+				}
+				else	// we are going to run into a prot region
+				{
+					count = min(toWrite, region->sector - sector);
+					
+					if(!dev_rawnand->write_sector(sector, count, devBufPtr))
+						return false;
+				}
+			}
+			else
+			{
+				count = toWrite;
+				
+				// no prot regions found, do a normal write
+				if(!dev_rawnand->write_sector(sector, count, devBufPtr))
+					return false;
+			}
+			
+			devBufPtr += count << 9;
+			sector += count;
+			toWrite -= count;
+		}
+		while(toWrite);
+	}
+	else
+	{
+		if(!dev_rawnand->write_sector(sector, count, buf))
+			return false;
+	}
+	
+	return true;
+}
+
 // Writes from a device buffer to a device or file.
 // Note: size must be <= cache size, else: error
 s32 fsWriteFromDeviceBuffer(s32 destHandle, u32 destOffset, u32 destSize, DevBufHandle devBufHandle)
@@ -412,7 +971,6 @@ s32 fsWriteFromDeviceBuffer(s32 destHandle, u32 destOffset, u32 destSize, DevBuf
 	FsDevice dev;
 	u32 sector, count;
 	bool toFile;
-	const ProtNandRegion *region;
 	
 	// destination is a device?
 	if(isValidDevHandle(destHandle))
@@ -472,168 +1030,482 @@ s32 fsWriteFromDeviceBuffer(s32 destHandle, u32 destOffset, u32 destSize, DevBuf
 		sector = destOffset >> 9;
 		count = count >> 9;
 		
-		
-		if(isNandProtected())
+		if(!rawNandWrite(sector, count, devBuf.mem))
+			return -31;
+	}
+
+	devBuf.dataSize = 0;
+	
+	return FR_OK;
+}
+
+// Validates an extent list and returns the total size or 0 on error
+static u32 checkIoVecs(const FsIoVec *vec, u32 num, bool sectorAligned)
+{
+	if(!vec || !num || num > FS_MAX_IOVECS) return 0;
+
+	u32 total = 0;
+	for(u32 i = 0; i < num; i++)
+	{
+		const u32 offset = vec[i].offset;
+		const u32 size = vec[i].size;
+
+		if(!size || offset > ~size || total > ~size) return 0;
+		if(sectorAligned && (offset % 0x200 || size % 0x200)) return 0;
+		total += size;
+	}
+
+	return total;
+}
+
+// Returns how many extents starting at vec[0] are back to back and can be
+// done in one transfer. If packed is false the buffers must be back to back too.
+static u32 mergeIoVecs(const FsIoVec *vec, u32 num, bool packed, u32 *size)
+{
+	u32 total = vec[0].size;
+	u32 i;
+	for(i = 1; i < num; i++)
+	{
+		const FsIoVec *const prev = &vec[i - 1];
+
+		if(prev->offset + prev->size != vec[i].offset) break;
+		if(!packed && (u8*)prev->buf + prev->size != (u8*)vec[i].buf) break;
+		total += vec[i].size;
+	}
+
+	*size = total;
+
+	return i;
+}
+
+static s32 fileTransferV(s32 handle, const FsIoVec *vec, u32 num, u8 *packedBuf, bool write)
+{
+	for(u32 i = 0; i < num; )
+	{
+		u32 size;
+		const u32 merged = mergeIoVecs(&vec[i], num - i, packedBuf != NULL, &size);
+		u8 *const buf = (packedBuf ? packedBuf : (u8*)vec[i].buf);
+
+		if(f_tell(getFile(handle)) != vec[i].offset)
 		{
-			u32 toWrite = count;
-			u8 *devBufPtr = devBuf.mem;
-			
-			/* check if we want to write to a protected area on NAND */
-			
-			do
-			{
-				region = getNandProtRegion(sector, toWrite);
-				
-				if(region)
-				{
-					// we're inside a prot region?
-					if(region->sector <= sector)
-					{
-						// calc how much do we need to skip
-						count = min(region->sector + region->count, sector + toWrite) - sector;
-					}
-					else	// we are going to run into a prot region
-					{
-						count = min(toWrite, region->sector - sector);
-						
-						if(!dev_rawnand->write_sector(sector, count, devBufPtr))
-							return -31;
-					}
-				}
-				else
-				{
-					count = toWrite;
-					
-					// no prot regions found, do a normal write
-					if(!dev_rawnand->write_sector(sector, count, devBufPtr))
-						return -31;
-				}
-				
-				devBufPtr += count << 9;
-				sector += count;
-				toWrite -= count;
-			}
-			while(toWrite);
+			const s32 res = fLseek(handle, vec[i].offset);
+			if(res != FR_OK) return res;
 		}
-		else
+
+		const s32 res = (write ? fWrite(handle, buf, size) : fRead(handle, buf, size));
+		if(res != FR_OK) return res;
+
+		if(packedBuf) packedBuf += size;
+		i += merged;
+	}
+
+	return FR_OK;
+}
+
+s32 fReadV(s32 handle, const FsIoVec *vec, u32 num)
+{
+	if(!isFileHandleValid(handle)) return -30;
+	if(!checkIoVecs(vec, num, false)) return -30;
+
+	return fileTransferV(handle, vec, num, NULL, false);
+}
+
+s32 fWriteV(s32 handle, const FsIoVec *vec, u32 num)
+{
+	if(!isFileHandleValid(handle)) return -30;
+	if(!checkIoVecs(vec, num, false)) return -30;
+
+	return fileTransferV(handle, vec, num, NULL, true);
+}
+
+// Like fReadToDeviceBuffer() but reads multiple extents. The data is
+// packed back to back into the device buffer in list order.
+s32 fReadToDeviceBufferV(s32 sourceHandle, const FsIoVec *vec, u32 num, DevBufHandle devBufHandle)
+{
+	bool fromFile;
+
+	if(isValidDevHandle(sourceHandle))
+	{
+		const FsDevice dev = getDeviceFromHandle(sourceHandle);
+
+		// for now...
+		if(!usesRawAccess(dev) || dev != FS_DEVICE_NAND)
+			return -30;
+
+		if(!dev_rawnand->is_active())
+			return -31;
+
+		fromFile = false;
+	}
+	else
+	{
+		if(!isFileHandleValid(sourceHandle))
+			return -30;
+
+		fromFile = true;
+	}
+
+	if(!isValidDevBufHandle(devBufHandle))
+		return -30;
+
+	const u32 total = checkIoVecs(vec, num, !fromFile);
+	if(!total || devBuf.memSize < total)
+		return -30;
+
+	if(fromFile)
+	{
+		if(fileTransferV(sourceHandle, vec, num, devBuf.mem, false) != FR_OK)
+			return -31;
+	}
+	else
+	{
+		u8 *devBufPtr = devBuf.mem;
+		for(u32 i = 0; i < num; )
 		{
-			if(!dev_rawnand->write_sector(sector, count, devBuf.mem))
+			const u32 start = vec[i].offset;
+			u32 size;
+			i += mergeIoVecs(&vec[i], num - i, true, &size);
+
+			if(!dev_rawnand->read_sector(start >> 9, size >> 9, devBufPtr))
 				return -31;
+
+			devBufPtr += size;
 		}
 	}
 
-	devBuf.dataSize = 0;
-	
+	devBuf.dataSize = total;
+
 	return FR_OK;
 }
 
-static s32 findUnusedFileSlot(void)
+// Like fsWriteFromDeviceBuffer() but writes multiple extents. The data is
+// taken back to back from the device buffer in list order.
+s32 fsWriteFromDeviceBufferV(s32 destHandle, const FsIoVec *vec, u32 num, DevBufHandle devBufHandle)
 {
-	if(fHandles >= FS_MAX_FILES) return -1;
+	bool toFile;
+
+	if(isValidDevHandle(destHandle))
+	{
+		const FsDevice dev = getDeviceFromHandle(destHandle);
+
+		// for now...
+		if(!usesRawAccess(dev) || dev != FS_DEVICE_NAND)
+			return -30;
+
+		if(!dev_rawnand->is_active())
+			return -31;
 
-	s32 i = 0;
-	while(i < FS_MAX_FILES)
+		toFile = false;
+	}
+	else
 	{
-		if(!fStatTable[i]) break;
-		i++;
+		if(!isFileHandleValid(destHandle))
+			return -30;
+
+		toFile = true;
 	}
 
-	if(i == FS_MAX_FILES) return -1;
-	else return i;
+	if(!isValidDevBufHandle(devBufHandle))
+		return -30;
+
+	const u32 total = checkIoVecs(vec, num, !toFile);
+	if(!total || devBuf.dataSize < total)
+		return -30;
+
+	if(toFile)
+	{
+		if(fileTransferV(destHandle, vec, num, devBuf.mem, true) != FR_OK)
+			return -31;
+	}
+	else
+	{
+		const u8 *devBufPtr = devBuf.mem;
+		for(u32 i = 0; i < num; )
+		{
+			const u32 start = vec[i].offset;
+			u32 size;
+			i += mergeIoVecs(&vec[i], num - i, true, &size);
+
+			if(!rawNandWrite(start >> 9, size >> 9, devBufPtr))
+				return -31;
+
+			devBufPtr += size;
+		}
+	}
+
+	devBuf.dataSize = 0;
+
+	return FR_OK;
+}
+
+// Takes a slot from the free list. Returns HANDLE_SLOT_NONE if all are in use.
+static u32 slabAlloc(HandleSlab *const slab)
+{
+	if(!slab->initialized)
+	{
+		for(u32 i = 0; i < slab->capacity; i++)
+			slab->next[i] = (i + 1 < slab->capacity ? i + 1 : HANDLE_SLOT_NONE);
+		slab->freeHead = 0;
+		slab->initialized = true;
+	}
+
+	const u32 slot = slab->freeHead;
+	if(slot == HANDLE_SLOT_NONE) return HANDLE_SLOT_NONE;
+
+	slab->freeHead = slab->next[slot];
+	slab->gen[slot]++;
+
+	return slot;
+}
+
+static void slabFree(HandleSlab *const slab, u32 slot)
+{
+	slab->gen[slot]++;
+	slab->next[slot] = slab->freeHead;
+	slab->freeHead = slot;
+}
+
+static inline s32 slabMakeHandle(const HandleSlab *const slab, u32 slot)
+{
+	return (s32)((slab->gen[slot] & HANDLE_GEN_MASK)<<16 | slot);
+}
+
+static bool slabIsHandleValid(const HandleSlab *const slab, s32 handle)
+{
+	const u32 slot = HANDLE_SLOT(handle);
+
+	if(handle < 0 || slot >= slab->capacity) return false;
+	const u32 gen = slab->gen[slot];
+	return (gen & 1u) && (gen & HANDLE_GEN_MASK) == HANDLE_GEN(handle);
 }
 
 static bool isFileHandleValid(s32 handle)
 {
-	if((u32)handle > fHandles) return false;
-	else return true;
+	return slabIsHandleValid(&fSlab, handle);
 }
 
 s32 fOpen(const char *const path, FsOpenMode mode)
 {
-	const s32 i = findUnusedFileSlot();
-	if(i < 0) return -30;
+	const u32 slot = slabAlloc(&fSlab);
+	if(slot == HANDLE_SLOT_NONE) return -30;
 
-	FRESULT res = f_open(&fTable[i], path, mode);
+	// Creating or truncating may allocate or free clusters
+	if(mode & ~FA_READ) fsModCount++;
+	FRESULT res = f_open(&fPool[slot], path, mode);
 	if(res == FR_OK)
 	{
-		fStatTable[i] = true;
-		fHandles++;
-		return i; // Handle
+		fContigTable[slot] = FS_CONTIG_UNKNOWN;
+		return slabMakeHandle(&fSlab, slot);
 	}
-	else return -res;
+	else
+	{
+		slabFree(&fSlab, slot);
+		return -res;
+	}
+}
+
+// Returns the first sector of the file if all clusters are back to back
+static u32 getContigSector(FIL *const fp)
+{
+	if(!fp->obj.sclust) return FS_CONTIG_NONE;
+
+	// A contiguous file has exactly one fragment in the cluster map
+	DWORD clmt[4];
+	clmt[0] = 4;
+	fp->cltbl = clmt;
+	const FRESULT res = f_lseek(fp, CREATE_LINKMAP);
+	fp->cltbl = NULL;
+	if(res != FR_OK) return FS_CONTIG_NONE;
+
+	const FATFS *const fs = fp->obj.fs;
+
+	return fs->database + fs->csize * (clmt[2] - 2);
+}
+
+s32 fOpenContiguous(const char *const path, FsOpenMode mode)
+{
+	const s32 handle = fOpen(path, mode);
+	if(handle < 0) return handle;
+
+	const u32 slot = HANDLE_SLOT(handle);
+	fContigTable[slot] = getContigSector(&fPool[slot]);
+	if(fContigTable[slot] == FS_CONTIG_NONE)
+	{
+		fClose(handle);
+		return FS_ERR_NOT_CONTIGUOUS;
+	}
+
+	return handle;
+}
+
+// Reads the whole sectors of a contiguous file in a single disk command
+// instead of splitting at every cluster. Returns the number of bytes read.
+static u32 readContiguous(s32 handle, u8 *const buf, u32 size)
+{
+	const u32 slot = HANDLE_SLOT(handle);
+	FIL *const fp = &fPool[slot];
+	const FATFS *const fs = fp->obj.fs;
+	const FSIZE_t pos = f_tell(fp);
+
+
+	// Writable files may have a dirty sector buffer
+	if(fp->flag & FA_WRITE || pos % 0x200 || pos >= f_size(fp)) return 0;
+
+	// FatFs reads up to a cluster in one go on its own
+	if(f_size(fp) - pos < size) size = f_size(fp) - pos;
+	size &= ~0x1FFu;
+	if(size < fs->csize * 0x200u) return 0;
+
+	if(fContigTable[slot] == FS_CONTIG_UNKNOWN) fContigTable[slot] = getContigSector(fp);
+	if(fContigTable[slot] == FS_CONTIG_NONE) return 0;
+
+	if(disk_read(fs->pdrv, buf, fContigTable[slot] + (pos>>9), size>>9) != RES_OK) return 0;
+	if(f_lseek(fp, pos + size) != FR_OK) return 0;
+
+	return size;
 }
 
 s32 fRead(s32 handle, void *const buf, u32 size)
 {
 	if(!isFileHandleValid(handle)) return -30;
 
+	const u32 rawSize = readContiguous(handle, buf, size);
+	if(rawSize == size) return FR_OK;
+
 	UINT bytesRead;
-	FRESULT res = f_read(&fTable[handle], buf, size, &bytesRead);
+	FRESULT res = f_read(getFile(handle), (u8*)buf + rawSize, size - rawSize, &bytesRead);
 
-	if(bytesRead != size) return -31;
-	if(res == FR_OK) return FR_OK;
-	else return -res;
+	if(res != FR_OK) return -res;
+	if(bytesRead != size - rawSize) return -31;
+	return FR_OK;
+}
+
+// Overwrites whole sectors of a contiguous file in a single disk command.
+// Only already allocated sectors are written so the FAT doesn't change.
+// Returns the number of bytes written.
+static u32 writeContiguous(s32 handle, const u8 *const buf, u32 size)
+{
+	const u32 slot = HANDLE_SLOT(handle);
+	FIL *const fp = &fPool[slot];
+	const FATFS *const fs = fp->obj.fs;
+	const FSIZE_t pos = f_tell(fp);
+
+
+	if(pos % 0x200 || pos >= f_size(fp)) return 0;
+
+	if(f_size(fp) - pos < size) size = f_size(fp) - pos;
+	size &= ~0x1FFu;
+	if(size < fs->csize * 0x200u) return 0;
+
+	if(fContigTable[slot] == FS_CONTIG_UNKNOWN) fContigTable[slot] = getContigSector(fp);
+	if(fContigTable[slot] == FS_CONTIG_NONE) return 0;
+
+	// The sector buffer of the file must neither overwrite
+	// the new data later nor return stale data.
+	if(fp->flag & FS_FIL_DIRTY && f_sync(fp) != FR_OK) return 0;
+	const u32 sector = fContigTable[slot] + (pos>>9);
+	if(fp->sect >= sector && fp->sect < sector + (size>>9)) fp->sect = 0;
+
+	if(disk_write(fs->pdrv, buf, sector, size>>9) != RES_OK) return 0;
+	if(f_lseek(fp, pos + size) != FR_OK) return 0;
+	fp->flag |= FS_FIL_MODIFIED; // Update the timestamp on close
+
+	return size;
 }
 
 s32 fWrite(s32 handle, const void *const buf, u32 size)
 {
 	if(!isFileHandleValid(handle)) return -30;
 
+	const u32 rawSize = writeContiguous(handle, buf, size);
+	if(rawSize == size) return FR_OK;
+
+	FIL *const fp = getFile(handle);
+	const FSIZE_t oldSize = f_size(fp);
 	UINT bytesWritten;
-	FRESULT res = f_write(&fTable[handle], buf, size, &bytesWritten);
+	FRESULT res = f_write(fp, (const u8*)buf + rawSize, size - rawSize, &bytesWritten);
 
-	if(bytesWritten != size) return -31;
-	if(res == FR_OK) return FR_OK;
-	else return -res;
+	// New clusters may break contiguity
+	if(f_size(fp) != oldSize)
+	{
+		fContigTable[HANDLE_SLOT(handle)] = FS_CONTIG_UNKNOWN;
+		fsModCount++;
+	}
+
+	if(res != FR_OK) return -res;
+	if(bytesWritten != size - rawSize) return -31;
+	return FR_OK;
 }
 
 s32 fSync(s32 handle)
 {
 	if(!isFileHandleValid(handle)) return -30;
 
-	FRESULT res = f_sync(&fTable[handle]);
+	FRESULT res = f_sync(getFile(handle));
 	if(res == FR_OK) return res;
 	else return -res;
 }
 
-s32 fLseek(s32 handle, u32 offset)
+s32 fLseek(s32 handle, u64 offset)
 {
 	if(!isFileHandleValid(handle)) return -30;
 
-	FRESULT res = f_lseek(&fTable[handle], offset);
+	FIL *const fp = getFile(handle);
+	const FSIZE_t oldSize = f_size(fp);
+	FRESULT res = f_lseek(fp, offset);
+	if(f_size(fp) != oldSize)
+	{
+		fContigTable[HANDLE_SLOT(handle)] = FS_CONTIG_UNKNOWN;
+		fsModCount++;
+	}
 	if(res == FR_OK) return res;
 	else return -res;
 }
 
-u32 fTell(s32 handle)
+u64 fTell(s32 handle)
+{
+	if(!isFileHandleValid(handle)) return 0;
+	return f_tell(getFile(handle));
+}
+
+u64 fSize(s32 handle)
 {
 	if(!isFileHandleValid(handle)) return 0;
-	return f_tell(&fTable[handle]);
+	return f_size(getFile(handle));
 }
 
-u32 fSize(s32 handle)
+u32 fGetStartCluster(s32 handle)
 {
 	if(!isFileHandleValid(handle)) return 0;
-	return f_size(&fTable[handle]);
+	return getFile(handle)->obj.sclust;
 }
 
 s32 fClose(s32 handle)
 {
-	if(fHandles == 0 || !isFileHandleValid(handle)) return -30;
+	if(!isFileHandleValid(handle)) return -30;
 
-	FRESULT res = f_close(&fTable[handle]);
-	fStatTable[handle] = false;
-	fHandles--;
+	const u32 slot = HANDLE_SLOT(handle);
+	if(fPool[slot].flag & FS_FIL_MODIFIED) fsModCount++; // Written in place
+	FRESULT res = f_close(&fPool[slot]);
+	slabFree(&fSlab, slot);
 
 	if(res == FR_OK) return FR_OK;
 	else return -res;
 }
 
-s32 fExpand(s32 handle, u32 size)
+// Closes whatever is open in the slot. Used on deinit.
+static void fCloseSlot(u32 slot)
+{
+	if(fGenTable[slot] & 1u) fClose(slabMakeHandle(&fSlab, slot));
+}
+
+s32 fExpand(s32 handle, u64 size)
 {
 	if(!isFileHandleValid(handle)) return -30;
 
-	FRESULT res = f_expand(&fTable[handle], size, 1);
+	FRESULT res = f_expand(getFile(handle), size, 1);
+	fContigTable[HANDLE_SLOT(handle)] = FS_CONTIG_UNKNOWN;
+	fsModCount++;
 	if(res == FR_OK) return res;
 	else return -res;
 }
@@ -645,40 +1517,23 @@ s32 fStat(const char *const path, FsFileInfo *fi)
 	else return -res;
 }
 
-static s32 findUnusedDirSlot(void)
-{
-	if(dHandles >= FS_MAX_DIRS) return -1;
-
-	s32 i = 0;
-	while(i < FS_MAX_DIRS)
-	{
-		if(!dStatTable[i]) break;
-		i++;
-	}
-
-	if(i == FS_MAX_DIRS) return -1;
-	else return i;
-}
-
 static bool isDirHandleValid(s32 handle)
 {
-	if((u32)handle > dHandles) return false;
-	else return true;
+	return slabIsHandleValid(&dSlab, handle);
 }
 
 s32 fOpenDir(const char *const path)
 {
-	const s32 i = findUnusedDirSlot();
-	if(i < 0) return -30;
+	const u32 slot = slabAlloc(&dSlab);
+	if(slot == HANDLE_SLOT_NONE) return -30;
 
-	FRESULT res = f_opendir(&dTable[i], path);
-	if(res == FR_OK)
+	FRESULT res = f_opendir(&dPool[slot], path);
+	if(res == FR_OK) return slabMakeHandle(&dSlab, slot);
+	else
 	{
-		dStatTable[i] = true;
-		dHandles++;
-		return i; // Handle
+		slabFree(&dSlab, slot);
+		return -res;
 	}
-	else return -res;
 }
 
 s32 fReadDir(s32 handle, FsFileInfo *fi, u32 num)
@@ -689,7 +1544,7 @@ s32 fReadDir(s32 handle, FsFileInfo *fi, u32 num)
 	u32 i;
 	for(i = 0; i < num; i++)
 	{
-		FRESULT res = f_readdir(&dTable[handle], &fi[i]);
+		FRESULT res = f_readdir(&dPool[HANDLE_SLOT(handle)], &fi[i]);
 		if(res != FR_OK) return -res;
 		if(!fi[i].fname[0]) break;
 	}
@@ -699,11 +1554,11 @@ s32 fReadDir(s32 handle, FsFileInfo *fi, u32 num)
 
 s32 fCloseDir(s32 handle)
 {
-	if(dHandles == 0 || !isDirHandleValid(handle)) return -30;
+	if(!isDirHandleValid(handle)) return -30;
 
-	FRESULT res = f_closedir(&dTable[handle]);
-	dStatTable[handle] = false;
-	dHandles--;
+	const u32 slot = HANDLE_SLOT(handle);
+	FRESULT res = f_closedir(&dPool[slot]);
+	slabFree(&dSlab, slot);
 
 	if(res == FR_OK) return FR_OK;
 	else return -res;
@@ -711,13 +1566,20 @@ s32 fCloseDir(s32 handle)
 
 s32 fMkdir(const char *const path)
 {
+	fsModCount++;
 	FRESULT res = f_mkdir(path);
 	if(res == FR_OK) return res;
 	else return -res;
 }
 
+u32 fGetModCount(void)
+{
+	return fsModCount;
+}
+
 s32 fRename(const char *const old, const char *const new)
 {
+	fsModCount++;
 	FRESULT res = f_rename(old, new);
 	if(res == FR_OK) return res;
 	else return -res;
@@ -725,6 +1587,7 @@ s32 fRename(const char *const old, const char *const new)
 
 s32 fUnlink(const char *const path)
 {
+	fsModCount++;
 	FRESULT res = f_unlink(path);
 	if(res == FR_OK) return res;
 	else return -res;
@@ -831,6 +1694,9 @@ s32 fSetNandProtection(bool protect)
 	
 	if(protect)
 	{
+		// Needed for the partition table
+		if(!initNandDevice()) return -31;
+		
 		numProtNandRegions = arrayEntries(defaultProt);
 		memcpy(protNandRegions, defaultProt, sizeof defaultProt);
 		
@@ -872,7 +1738,7 @@ s32 fSetNandProtection(bool protect)
 
 void fsDeinit(void)
 {
-	for(u32 i = 0; i < FS_MAX_FILES; i++) fClose(i);
+	for(u32 i = 0; i < FS_MAX_FILES; i++) fCloseSlot(i);
 	for(u32 i = 0; i < FS_MAX_DRIVES; i++) fUnmount(i);
 
 	dev_decnand->close();
@@ -23,6 +23,7 @@
 #include "arm9/hardware/cfg9.h"
 #include "arm9/hardware/interrupt.h"
 #include "arm9/hardware/ndma.h"
+#include "hardware/cache.h"
 #include "arm.h"
 #include "mmio.h"
 
@@ -63,6 +64,9 @@
 #define REG_AESKEYYFIFO       ((vu32*)(AES_REGS_BASE + 0x108))
 
 
+// Keyslot currently loaded into the AES engine. 0xFF = none.
+static u8 selectedKeyslot = 0xFF;
+
 
 static void setupKeys(void)
 {
@@ -168,6 +172,7 @@ static void setupKeys(void)
 
 void AES_init(void)
 {
+	selectedKeyslot = 0xFF;
 	REG_AESCNT = AES_MAC_SIZE(4) | AES_FLUSH_WRITE_FIFO | AES_FLUSH_READ_FIFO;
 	*((vu8*)0x10000008) = 0; // ??
 
@@ -188,6 +193,9 @@ void AES_setKey(u8 keyslot, AesKeyType type, u8 orderEndianess, bool twlScramble
 	fb_assert(key != NULL);
 
 
+	// The engine only picks up the new key on the next select
+	if(keyslot == selectedKeyslot) selectedKeyslot = 0xFF;
+
 	REG_AESCNT = (u32)orderEndianess<<23;
 	if(keyslot > 3)
 	{
@@ -212,8 +220,11 @@ void AES_selectKeyslot(u8 keyslot)
 {
 	fb_assert(keyslot < 0x40);
 
+	if(keyslot == selectedKeyslot) return;
+
 	REG_AESKEYSEL = keyslot;
 	REG_AESCNT |= AES_UPDATE_KEYSLOT;
+	selectedKeyslot = keyslot;
 }
 
 void AES_setNonce(AES_ctx *const ctx, u8 orderEndianess, const u32 nonce[3])
@@ -358,76 +369,206 @@ void AES_ctr(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool dma)
 	}
 }
 
-/*void AES_cbc(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool enc, bool dma)
+void AES_ctrFifoStart(AES_ctx *const ctx, u32 fifo, u32 startup, u32 *buf, u32 blocks, bool fromFifo)
+{
+	fb_assert(ctx != NULL);
+	fb_assert(buf != NULL);
+	fb_assert(((u32)buf & 3u) == 0);
+	fb_assert(((u32)buf >= ITCM_BOOT9_MIRROR + ITCM_SIZE) && (((u32)buf < DTCM_BASE) || ((u32)buf >= DTCM_BASE + DTCM_SIZE)));
+	fb_assert(blocks != 0 && (blocks & 1u) == 0 && blocks <= AES_MAX_BLOCKS);
+
+	u32 *const ctr = ctx->ctrIvNonce;
+
+
+	REG_AESCNT = ctx->ctrIvNonceParams;
+	for(u32 i = 0; i < 4; i++) REG_AESCTR[i] = ctr[i];
+	REG_AESCNT = AES_MODE_CTR | ctx->aesParams;
+
+	// Always 32 bytes FIFO size. The peripheral side is throttled by its
+	// own startup mode in 8 words steps which the AES FIFOs can take.
+	if(fromFifo)
+	{
+		REG_NDMA0_SRC_ADDR = fifo;
+		REG_NDMA0_TOTAL_CNT = blocks<<2;
+		REG_NDMA0_LOG_BLK_CNT = 8;
+		REG_NDMA0_CNT = NDMA_ENABLE | NDMA_TOTAL_CNT_MODE | startup |
+		                NDMA_BURST_WORDS(8) | NDMA_SRC_UPDATE_FIXED | NDMA_DST_UPDATE_FIXED;
+
+		REG_NDMA1_DST_ADDR = (u32)buf;
+		REG_NDMA1_TOTAL_CNT = blocks<<2;
+		REG_NDMA1_LOG_BLK_CNT = 8;
+		REG_NDMA1_CNT = NDMA_ENABLE | NDMA_TOTAL_CNT_MODE | NDMA_STARTUP_AES_OUT |
+		                NDMA_BURST_WORDS(8) | NDMA_SRC_UPDATE_FIXED | NDMA_DST_UPDATE_INC;
+	}
+	else
+	{
+		REG_NDMA0_SRC_ADDR = (u32)buf;
+		REG_NDMA0_TOTAL_CNT = blocks<<2;
+		REG_NDMA0_LOG_BLK_CNT = 8;
+		REG_NDMA0_CNT = NDMA_ENABLE | NDMA_TOTAL_CNT_MODE | NDMA_STARTUP_AES_IN |
+		                NDMA_BURST_WORDS(8) | NDMA_SRC_UPDATE_INC | NDMA_DST_UPDATE_FIXED;
+
+		REG_NDMA1_DST_ADDR = fifo;
+		REG_NDMA1_TOTAL_CNT = blocks<<2;
+		REG_NDMA1_LOG_BLK_CNT = 8;
+		REG_NDMA1_CNT = NDMA_ENABLE | NDMA_TOTAL_CNT_MODE | startup |
+		                NDMA_BURST_WORDS(8) | NDMA_SRC_UPDATE_FIXED | NDMA_DST_UPDATE_FIXED;
+	}
+
+	REG_AES_BLKCNT_HIGH = blocks;
+	REG_AESCNT |= AES_ENABLE | 1u<<14 | 2u<<12 | AES_FLUSH_READ_FIFO | AES_FLUSH_WRITE_FIFO;
+
+	AES_addCounter(ctr, blocks<<4);
+}
+
+void AES_ctrFifoFinish(bool abort)
+{
+	if(abort)
+	{
+		REG_NDMA0_CNT = 0;
+		REG_NDMA1_CNT = 0;
+		REG_AESCNT = AES_FLUSH_READ_FIFO | AES_FLUSH_WRITE_FIFO;
+		return;
+	}
+
+	// The peripheral transfer already ended so this doesn't take long
+	while(REG_AESCNT & AES_ENABLE);
+	// NDMA1 may still be draining the last burst
+	while(REG_NDMA1_CNT & NDMA_ENABLE);
+}
+
+void AES_cbc(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool enc, bool dma)
 {
 	fb_assert(ctx != NULL);
 	fb_assert(in != NULL);
 	fb_assert(out != NULL);
 
-	const u32 ivParams = ctx->ctrIvNonceParams;
-	u32 *const iv = ctx->ctrIvNonce;
 	const u32 aesParams = (enc ? AES_MODE_CBC_ENCRYPT : AES_MODE_CBC_DECRYPT) | ctx->aesParams;
+	// The next IV is the last ciphertext block. Take over its word order.
+	const u8 ivOrder = (enc ? aesParams>>22 : aesParams>>23) & (AES_INPUT_BIG | AES_INPUT_NORMAL);
 
 
 	while(blocks)
 	{
-		REG_AESCNT = ivParams;
-		REG_AESCTR[0] = iv[0];
-		REG_AESCTR[1] = iv[1];
-		REG_AESCTR[2] = iv[2];
-		REG_AESCTR[3] = iv[3];
+		const u32 *const iv = ctx->ctrIvNonce;
+		REG_AESCNT = ctx->ctrIvNonceParams;
+		for(u32 i = 0; i < 4; i++) REG_AESCTR[i] = iv[i];
 
-		u32 blockNum = ((blocks > AES_MAX_BLOCKS) ? AES_MAX_BLOCKS : blocks);
+		const u32 blockNum = ((blocks > AES_MAX_BLOCKS) ? AES_MAX_BLOCKS : blocks);
 
-		if(!enc)
-		{
-			// Save last 16 bytes of the input blocks as next IV
-			const u32 *const nextIv = in + (blockNum<<2) - 4;
-			if(aesParams>>23 & AES_INPUT_NORMAL)
-			{
-				iv[0] = nextIv[3];
-				iv[1] = nextIv[2];
-				iv[2] = nextIv[1];
-				iv[3] = nextIv[0];
-			}
-			else
-			{
-				iv[0] = nextIv[0];
-				iv[1] = nextIv[1];
-				iv[2] = nextIv[2];
-				iv[3] = nextIv[3];
-			}
-		}
+		// Save the last input block before it gets overwritten (in-place)
+		u32 nextIv[4];
+		if(!enc) for(u32 i = 0; i < 4; i++) nextIv[i] = in[(blockNum<<2) - 4 + i];
 
 		REG_AESCNT = aesParams;
-		if(dma) aesProcessBlocksDma(in, out, blockNum);
+		if(dma)
+		{
+			aesProcessBlocksDma(in, out, blockNum);
+			// Reading nextIv cached the last input block. In-place the DMA replaced it in memory.
+			if(!enc) invalidateDCacheRange(&in[(blockNum<<2) - 4], 16);
+		}
 		else aesProcessBlocksCpu(in, out, blockNum);
 
 		if(enc)
 		{
-			// Save last 16 bytes of the output blocks as next IV
-			const u32 *const nextIv = out + (blockNum<<2) - 4;
-			if(aesParams>>23 & AES_INPUT_NORMAL)
-			{
-				iv[0] = nextIv[3];
-				iv[1] = nextIv[2];
-				iv[2] = nextIv[1];
-				iv[3] = nextIv[0];
-			}
-			else
-			{
-				iv[0] = nextIv[0];
-				iv[1] = nextIv[1];
-				iv[2] = nextIv[2];
-				iv[3] = nextIv[3];
-			}
+			const u32 *const lastOut = out + (blockNum<<2) - 4;
+			if(dma) invalidateDCacheRange(lastOut, 16);
+			for(u32 i = 0; i < 4; i++) nextIv[i] = lastOut[i];
 		}
+		AES_setCtrIv(ctx, ivOrder, nextIv);
 
 		in += blockNum<<2;
 		out += blockNum<<2;
 		blocks -= blockNum;
 	}
-}*/
+}
+
+// Like aesProcessBlocksDma() but the output is thrown away except for the last block.
+static void aesMacBlocksDma(const u32 *in, u32 blocks, u32 last[4])
+{
+	fb_assert(((u32)in >= ITCM_BOOT9_MIRROR + ITCM_SIZE) && (((u32)in < DTCM_BASE) || ((u32)in >= DTCM_BASE + DTCM_SIZE)));
+
+	// 1 cache line. NDMA1 writes every output burst to the start of it.
+	alignas(32) static u32 scratch[8];
+
+
+	const u8 aesFifoSize = (blocks & 1u ? 0u : 1u); // 1 = 32 bytes, 0 = 16 bytes
+
+	REG_NDMA0_SRC_ADDR = (u32)in;
+	REG_NDMA0_TOTAL_CNT = blocks<<2;
+	REG_NDMA0_LOG_BLK_CNT = aesFifoSize * 4 + 4;
+	REG_NDMA0_CNT = NDMA_ENABLE | NDMA_TOTAL_CNT_MODE | NDMA_STARTUP_AES_IN |
+	                NDMA_BURST_WORDS(4) | NDMA_SRC_UPDATE_INC | NDMA_DST_UPDATE_FIXED;
+
+	REG_NDMA1_DST_ADDR = (u32)scratch;
+	REG_NDMA1_TOTAL_CNT = blocks<<2;
+	REG_NDMA1_LOG_BLK_CNT = aesFifoSize * 4 + 4;
+	REG_NDMA1_CNT = NDMA_ENABLE | NDMA_TOTAL_CNT_MODE | NDMA_STARTUP_AES_OUT |
+	                NDMA_BURST_WORDS(4) | NDMA_SRC_UPDATE_FIXED | NDMA_DST_UPDATE_INC |
+	                NDMA_DST_ADDR_RELOAD;
+
+	REG_AES_BLKCNT_HIGH = blocks;
+	REG_AESCNT |= AES_ENABLE | AES_IRQ_ENABLE | aesFifoSize<<14 | (3 - aesFifoSize)<<12 |
+	              AES_FLUSH_READ_FIFO | AES_FLUSH_WRITE_FIFO;
+	do
+	{
+		__wfi();
+	} while(REG_AESCNT & AES_ENABLE);
+	while(REG_NDMA1_CNT & NDMA_ENABLE);
+
+	invalidateDCacheRange(scratch, sizeof(scratch));
+	for(u32 i = 0; i < 4; i++) last[i] = scratch[aesFifoSize * 4 + i];
+}
+
+static void aesMacBlocksCpu(const u32 *in, u32 blocks, u32 last[4])
+{
+	REG_AES_BLKCNT_HIGH = blocks;
+	REG_AESCNT |= AES_ENABLE | 3u<<12 | AES_FLUSH_READ_FIFO | AES_FLUSH_WRITE_FIFO;
+
+	for(u32 i = 0; i < blocks * 4; i += 4)
+	{
+		*((vu32*)REG_AESWRFIFO) = in[i];
+		*((vu32*)REG_AESWRFIFO) = in[i + 1];
+		*((vu32*)REG_AESWRFIFO) = in[i + 2];
+		*((vu32*)REG_AESWRFIFO) = in[i + 3];
+
+		while(AES_READ_FIFO_COUNT == 0);
+
+		last[0] = *((vu32*)REG_AESRDFIFO);
+		last[1] = *((vu32*)REG_AESRDFIFO);
+		last[2] = *((vu32*)REG_AESRDFIFO);
+		last[3] = *((vu32*)REG_AESRDFIFO);
+	}
+}
+
+void AES_cbcMac(AES_ctx *const ctx, const u32 *in, u32 blocks, u32 mac[4], bool dma)
+{
+	fb_assert(ctx != NULL);
+	fb_assert(in != NULL);
+	fb_assert(mac != NULL);
+
+	const u32 aesParams = AES_MODE_CBC_ENCRYPT | ctx->aesParams;
+	const u8 ivOrder = (aesParams>>22) & (AES_INPUT_BIG | AES_INPUT_NORMAL);
+
+
+	while(blocks)
+	{
+		const u32 *const iv = ctx->ctrIvNonce;
+		REG_AESCNT = ctx->ctrIvNonceParams;
+		for(u32 i = 0; i < 4; i++) REG_AESCTR[i] = iv[i];
+
+		const u32 blockNum = ((blocks > AES_MAX_BLOCKS) ? AES_MAX_BLOCKS : blocks);
+		REG_AESCNT = aesParams;
+		if(dma) aesMacBlocksDma(in, blockNum, mac);
+		else aesMacBlocksCpu(in, blockNum, mac);
+
+		// Chain the next call/chunk on the last ciphertext block
+		AES_setCtrIv(ctx, ivOrder, mac);
+
+		in += blockNum<<2;
+		blocks -= blockNum;
+	}
+}
 
 void AES_ecb(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool enc, bool dma)
 {
@@ -516,6 +657,28 @@ void SHA_update(const u32 *data, u32 size)
 	if(size) iomemcpy(REGs_SHA_INFIFO, data, size);
 }
 
+void SHA_updateDmaAsync(const u32 *data, u32 size)
+{
+	fb_assert(((u32)data >= ITCM_BOOT9_MIRROR + ITCM_SIZE) && (((u32)data < DTCM_BASE) || ((u32)data >= DTCM_BASE + DTCM_SIZE)));
+	fb_assert((size & 63u) == 0);
+
+	if(!size) return;
+
+	REG_NDMA2_SRC_ADDR = (u32)data;
+	REG_NDMA2_DST_ADDR = (u32)REGs_SHA_INFIFO;
+	REG_NDMA2_TOTAL_CNT = size / 4;
+	REG_NDMA2_LOG_BLK_CNT = 64 / 4;
+	REG_NDMA2_INT_CNT = NDMA_INT_SYS_FREQ;
+	REG_NDMA2_CNT = NDMA_ENABLE | NDMA_TOTAL_CNT_MODE | NDMA_STARTUP_SHA_IN | NDMA_BURST_WORDS(64 / 4) |
+	                NDMA_SRC_UPDATE_INC | NDMA_DST_UPDATE_INC | NDMA_DST_ADDR_RELOAD;
+}
+
+void SHA_waitDma(void)
+{
+	while(REG_NDMA2_CNT & NDMA_ENABLE);
+	while(REG_SHA_CNT & SHA_ENABLE);
+}
+
 void SHA_finish(u32 *const hash, u8 endianess)
 {
 	REG_SHA_CNT = (REG_SHA_CNT & SHA_MODE_MASK) | endianess | SHA_FINAL_ROUND;
@@ -654,10 +817,10 @@ bool RSA_decrypt2048(u32 *const decSig, const u32 *const encSig)
 	return true;
 }
 
-bool RSA_verify2048(const u32 *const encSig, const u32 *const data, u32 size)
+bool RSA_verify2048Hash(const u32 *const encSig, const u32 hash[8])
 {
 	fb_assert(encSig != NULL);
-	fb_assert(data != NULL);
+	fb_assert(hash != NULL);
 
 	alignas(4) u8 decSig[0x100];
 	if(!RSA_decrypt2048((u32*)decSig, encSig)) return false;
@@ -670,12 +833,20 @@ bool RSA_verify2048(const u32 *const encSig, const u32 *const data, u32 size)
 	// ASN.1 is a clusterfuck so we skip parsing the remaining headers
 	// and hardcode the hash location.
 
-	u32 calcHash[8];
-	sha(data, size, calcHash, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
-
 	// Compare hash
 	u32 res = 0;
-	for(u32 i = 0; i < 8; i++) res |= ((u32*)(decSig + 0xE0))[i] ^ calcHash[i];
+	for(u32 i = 0; i < 8; i++) res |= ((u32*)(decSig + 0xE0))[i] ^ hash[i];
 
 	return res == 0;
 }
+
+bool RSA_verify2048(const u32 *const encSig, const u32 *const data, u32 size)
+{
+	fb_assert(encSig != NULL);
+	fb_assert(data != NULL);
+
+	u32 calcHash[8];
+	sha(data, size, calcHash, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+
+	return RSA_verify2048Hash(encSig, calcHash);
+}
@@ -30,6 +30,10 @@
 
 #define DATA32_SUPPORT
 
+// CMD13 polls before giving up on a busy card. Each takes a few us so
+// this allows several seconds for large erases.
+#define SDMMC_READY_RETRIES  (1000000u)
+
 
 struct mmcdevice handleNAND;
 struct mmcdevice handleSD;
@@ -79,6 +83,8 @@ static void sdmmc_send_command(struct mmcdevice *ctx, u32 cmd, u32 args)
 	sdmmc_write16(REG_SDSTATUS0,0);
 	sdmmc_write16(REG_SDSTATUS1,0);
 	sdmmc_mask16(REG_DATACTL32,0x1800,0x400); // Disable TX32RQ and RX32RDY IRQ. Clear fifo.
+	// The TX32RQ/RX32RDY IRQ enable bits double as NDMA request lines.
+	if(ctx->dma) sdmmc_mask16(REG_DATACTL32,0,(readdata ? 0x800 : 0x1000));
 	sdmmc_write16(REG_SDCMDARG0,args &0xFFFF);
 	sdmmc_write16(REG_SDCMDARG1,args >> 16);
 	sdmmc_write16(REG_SDCMD,cmd &0xFFFF);
@@ -90,8 +96,9 @@ static void sdmmc_send_command(struct mmcdevice *ctx, u32 cmd, u32 args)
 	const u32 *tDataPtr32 = (u32*)ctx->tData;
 	const u8  *tDataPtr8  = ctx->tData;
 
-	bool rUseBuf = ( NULL != rDataPtr32 );
-	bool tUseBuf = ( NULL != tDataPtr32 );
+	// In DMA mode the FIFO is drained/filled by NDMA and we only wait for the end.
+	bool rUseBuf = ( NULL != rDataPtr32 && !ctx->dma );
+	bool tUseBuf = ( NULL != tDataPtr32 && !ctx->dma );
 
 	u16 status0 = 0;
 	while(1)
@@ -104,7 +111,7 @@ static void sdmmc_send_command(struct mmcdevice *ctx, u32 cmd, u32 args)
 		if((status1 & TMIO_STAT1_RXRDY))
 #endif
 		{
-			if(readdata)
+			if(readdata && !ctx->dma)
 			{
 				if(rUseBuf)
 				{
@@ -161,7 +168,7 @@ static void sdmmc_send_command(struct mmcdevice *ctx, u32 cmd, u32 args)
 		if((status1 & TMIO_STAT1_TXRQ))
 #endif
 		{
-			if(writedata)
+			if(writedata && !ctx->dma)
 			{
 				if(tUseBuf)
 				{
@@ -234,6 +241,7 @@ static void sdmmc_send_command(struct mmcdevice *ctx, u32 cmd, u32 args)
 				break;
 		}
 	}
+	if(ctx->dma) sdmmc_mask16(REG_DATACTL32,0x1800,0);
 	ctx->stat0 = sdmmc_read16(REG_SDSTATUS0);
 	ctx->stat1 = sdmmc_read16(REG_SDSTATUS1);
 	sdmmc_write16(REG_SDSTATUS0,0);
@@ -314,6 +322,87 @@ int sdmmc_nand_writesectors(u32 sector_no, u32 numsectors, const u8 *in) //exper
 	return get_error(&handleNAND);
 }
 
+int sdmmc_nand_readsectors_dma(u32 sector_no, u32 numsectors)
+{
+	if(handleNAND.isSDHC == 0) sector_no <<= 9;
+	set_target(&handleNAND);
+	sdmmc_write16(REG_SDSTOP,0x100);
+	sdmmc_write16(REG_SDBLKCOUNT32,numsectors);
+	sdmmc_write16(REG_SDBLKLEN32,0x200);
+	sdmmc_write16(REG_SDBLKCOUNT,numsectors);
+	handleNAND.dma = 1;
+	handleNAND.size = numsectors << 9;
+	sdmmc_send_command(&handleNAND,0x33C12,sector_no);
+	handleNAND.dma = 0;
+	return get_error(&handleNAND);
+}
+
+int sdmmc_nand_writesectors_dma(u32 sector_no, u32 numsectors)
+{
+	if(handleNAND.isSDHC == 0) sector_no <<= 9;
+	set_target(&handleNAND);
+	sdmmc_write16(REG_SDSTOP,0x100);
+	sdmmc_write16(REG_SDBLKCOUNT32,numsectors);
+	sdmmc_write16(REG_SDBLKLEN32,0x200);
+	sdmmc_write16(REG_SDBLKCOUNT,numsectors);
+	handleNAND.dma = 1;
+	handleNAND.size = numsectors << 9;
+	sdmmc_send_command(&handleNAND,0x52C19,sector_no);
+	handleNAND.dma = 0;
+	return get_error(&handleNAND);
+}
+
+// Polls CMD13 until the card is back in transfer state and ready for data.
+// Needed after R1b commands like ERASE. Returns -2 if the card stays busy.
+static int sdmmc_wait_ready(struct mmcdevice *ctx)
+{
+	for(u32 i = 0; i < SDMMC_READY_RETRIES; i++)
+	{
+		sdmmc_send_command(ctx,0x1040D,ctx->initarg << 0x10);
+		if((ctx->error & 0x4)) return -1;
+		if((ctx->ret[0] & 0x1F00) == 0x900) return 0; // READY_FOR_DATA and state tran
+	}
+
+	return -2;
+}
+
+// Sends the erase start, erase end and ERASE commands for the given range.
+static int sdmmc_erase(struct mmcdevice *ctx, u32 startCmd, u32 endCmd, u32 eraseArg, u32 sector_no, u32 numsectors)
+{
+	u32 end = sector_no + numsectors - 1;
+	if(ctx->isSDHC == 0)
+	{
+		sector_no <<= 9;
+		end <<= 9;
+	}
+	set_target(ctx);
+
+	sdmmc_send_command(ctx,startCmd,sector_no);
+	if((ctx->error & 0x4)) return -1;
+	sdmmc_send_command(ctx,endCmd,end);
+	if((ctx->error & 0x4)) return -1;
+	sdmmc_send_command(ctx,0x10526,eraseArg);
+	if((ctx->error & 0x4)) return -1;
+
+	return sdmmc_wait_ready(ctx);
+}
+
+int sdmmc_sdcard_erasesectors(u32 sector_no, u32 numsectors)
+{
+	// CMD32 ERASE_WR_BLK_START, CMD33 ERASE_WR_BLK_END, CMD38 ERASE
+	return sdmmc_erase(&handleSD,0x10420,0x10421,0,sector_no,numsectors);
+}
+
+int sdmmc_nand_trimsectors(u32 sector_no, u32 numsectors)
+{
+	// CMD38 with the TRIM argument is illegal before eMMC 4.4. Nothing to do then.
+	if(handleNAND.canTrim == 0) return 0;
+
+	// CMD35 ERASE_GROUP_START, CMD36 ERASE_GROUP_END, CMD38 with the TRIM argument.
+	// Unlike a plain erase TRIM works on write blocks instead of erase groups.
+	return sdmmc_erase(&handleNAND,0x10423,0x10424,1,sector_no,numsectors);
+}
+
 static u32 sdmmc_calc_size(u8* csd, int type)
 {
   u32 result = 0;
@@ -348,14 +437,17 @@ void sdmmc_init()
 {
 	//NAND
 	handleNAND.isSDHC = 0;
+	handleNAND.dma = 0;
 	handleNAND.SDOPT = 0;
 	handleNAND.res = 0;
 	handleNAND.initarg = 1;
 	handleNAND.clk = 0x20; // 523.655968 KHz
 	handleNAND.devicenumber = 1;
+	handleNAND.canTrim = 0;
 
 	//SD
 	handleSD.isSDHC = 0;
+	handleSD.dma = 0;
 	handleSD.SDOPT = 0;
 	handleSD.res = 0;
 	handleSD.initarg = 0;
@@ -424,6 +516,8 @@ int Nand_Init()
 	sdmmc_send_command(&handleNAND,0x10609,handleNAND.initarg << 0x10);
 	if((handleNAND.error & 0x4))return -1;
 
+	// CSD SPEC_VERS. EXT_CSD exists since MMC 4.0.
+	const bool hasExtCsd = ((((u8*)handleNAND.ret)[14] >> 2) & 0xF) >= 4;
 	handleNAND.total_size = sdmmc_calc_size((u8*)&handleNAND.ret[0],0);
 	setckl(0x201); // 16.756991 MHz
 
@@ -446,6 +540,22 @@ int Nand_Init()
 	sdmmc_send_command(&handleNAND,0x10410,0x200);
 	if((handleNAND.error & 0x4))return -1;
 
+	// CMD8 SEND_EXT_CSD. SEC_FEATURE_SUPPORT bit 4 (SEC_GB_CL_EN) means TRIM is supported.
+	handleNAND.canTrim = 0;
+	if(hasExtCsd)
+	{
+		u32 extCsd[512 / 4];
+		sdmmc_write16(REG_SDSTOP,0);
+		sdmmc_write16(REG_SDBLKCOUNT32,1);
+		sdmmc_write16(REG_SDBLKLEN32,0x200);
+		sdmmc_write16(REG_SDBLKCOUNT,1);
+		handleNAND.rData = (u8*)extCsd;
+		handleNAND.size = 0x200;
+		sdmmc_send_command(&handleNAND,0x31C08,0);
+		handleNAND.rData = NULL;
+		if(!(handleNAND.error & 0x4)) handleNAND.canTrim = (((u8*)extCsd)[231] >> 4) & 1;
+	}
+
 	return 0;
 }
 
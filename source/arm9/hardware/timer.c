@@ -76,6 +76,35 @@ u16 TIMER_stop(Timer timer)
 	return REG_TIMER_VAL(timer);
 }
 
+void TIMER_startCounter32(void)
+{
+	REG_TIMER0_CNT = 0;
+	REG_TIMER1_CNT = 0;
+	REG_TIMER0_VAL = 0;
+	REG_TIMER1_VAL = 0;
+	REG_TIMER1_CNT = TIMER_ENABLE | TIMER_COUNT_UP;
+	REG_TIMER0_CNT = TIMER_ENABLE | TIMER_PRESCALER_1;
+}
+
+u32 TIMER_getCounter32(void)
+{
+	// Reread if timer 0 overflowed in between
+	u16 hi, lo;
+	do
+	{
+		hi = REG_TIMER1_VAL;
+		lo = REG_TIMER0_VAL;
+	} while(hi != REG_TIMER1_VAL);
+
+	return (u32)hi<<16 | lo;
+}
+
+void TIMER_stopCounter32(void)
+{
+	REG_TIMER0_CNT = 0;
+	REG_TIMER1_CNT = 0;
+}
+
 void TIMER_sleep(u32 ms)
 {
 	REG_TIMER3_VAL = TIMER_FREQ_64(1000);
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include "types.h"
 #include "mem_map.h"
+#include "util.h"
 #include "ipc_handler.h"
 #include "hardware/cache.h"
 #include "arm9/debug.h"
@@ -26,6 +27,8 @@
 #include "arm9/firm.h"
 #include "firmwriter.h"
 #include "arm9/hardware/cfg9.h"
+#include "job.h"
+#include "benchmark.h"
 
 
 
@@ -85,23 +88,48 @@ u32 IPC_handleCmd(u8 cmdId, u32 inBufs, u32 outBufs, const u32 *const buf)
 		case IPC_CMD_ID_MASK(IPC_CMD9_FWRITE):
 			result = fWrite(buf[2], (const void *const)buf[0], buf[1]);
 			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_FREADV):
+			{
+				const FsIoVec *const vec = (const FsIoVec*)buf[0];
+				const u32 num = buf[1] / sizeof(FsIoVec);
+				result = fReadV(buf[2], vec, num);
+				// The extent buffers are not IPC buffers. Flush them manually.
+				for(u32 i = 0; i < num && i < FS_MAX_IOVECS; i++)
+					flushInvalidateDCacheRange(vec[i].buf, vec[i].size);
+			}
+			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_FWRITEV):
+			{
+				const FsIoVec *const vec = (const FsIoVec*)buf[0];
+				const u32 num = buf[1] / sizeof(FsIoVec);
+				for(u32 i = 0; i < num && i < FS_MAX_IOVECS; i++)
+					invalidateDCacheRange(vec[i].buf, vec[i].size);
+				result = fWriteV(buf[2], vec, num);
+			}
+			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_FREADV_TO_DEV_BUF):
+			result = fReadToDeviceBufferV(buf[2], (const FsIoVec*)buf[0], buf[1] / sizeof(FsIoVec), buf[3]);
+			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_FWRITEV_FROM_DEV_BUF):
+			result = fsWriteFromDeviceBufferV(buf[2], (const FsIoVec*)buf[0], buf[1] / sizeof(FsIoVec), buf[3]);
+			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FSYNC):
 			result = fSync(buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FLSEEK):
-			result = fLseek(buf[0], buf[1]);
+			result = fLseek(buf[0], (u64)buf[2]<<32 | buf[1]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FTELL):
-			result = fTell(buf[0]);
+			*(u64*)buf[0] = fTell(buf[2]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FSIZE):
-			result = fSize(buf[0]);
+			*(u64*)buf[0] = fSize(buf[2]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FCLOSE):
 			result = fClose(buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FEXPAND):
-			result = fExpand(buf[0], buf[1]);
+			result = fExpand(buf[0], (u64)buf[2]<<32 | buf[1]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FSTAT):
 			result = fStat((const char *const)buf[0], (FsFileInfo*)buf[2]);
@@ -110,7 +138,7 @@ u32 IPC_handleCmd(u8 cmdId, u32 inBufs, u32 outBufs, const u32 *const buf)
 			result = fOpenDir((const char *const)buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FREAD_DIR):
-			result = fReadDir(buf[2], (FsFileInfo*)buf[0], buf[3]);
+			result = fReadDir(buf[2], (FsFileInfo*)buf[0], min(buf[3], buf[1] / sizeof(FsFileInfo)));
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FCLOSE_DIR):
 			result = fCloseDir(buf[0]);
@@ -130,12 +158,18 @@ u32 IPC_handleCmd(u8 cmdId, u32 inBufs, u32 outBufs, const u32 *const buf)
 		case IPC_CMD_ID_MASK(IPC_CMD9_FSET_NAND_PROT):
 			result = fSetNandProtection(buf[0]);
 			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_FDISCARD_FREE):
+			result = fDiscardFreeSpace(buf[0]);
+			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_WRITE_FIRM_PART):
 			result = writeFirmPartition((const char *const)buf[0], (bool)buf[2]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_LOAD_VERIFY_FIRM):
 			result = loadVerifyFirm((const char *const)buf[0], buf[2], false);
 			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_PREFETCH_FIRM):
+			result = prefetchFirm((const char *const)buf[0]);
+			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FIRM_LAUNCH):
 			{
 				extern volatile bool g_startFirmLaunch;
@@ -156,6 +190,18 @@ u32 IPC_handleCmd(u8 cmdId, u32 inBufs, u32 outBufs, const u32 *const buf)
 		case IPC_CMD_ID_MASK(IPC_CMD9_EXCEPTION):
 			fsDeinit();
 			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_JOB_GET_STATUS):
+			result = JOB_getStatus(buf[2], (JobStatus*)buf[0]);
+			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_BENCHMARK_CRYPTO):
+			result = benchmarkCrypto((BenchResult*)buf[0], buf[1] / sizeof(BenchResult));
+			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_SELFTEST_CRYPTO):
+			result = selftestCrypto();
+			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_ENABLE_FIRM_CACHE):
+			result = enableFirmCache(buf[0]);
+			break;
 		default:
 			panic();
 	}
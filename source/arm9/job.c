@@ -0,0 +1,277 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "types.h"
+#include "job.h"
+#include "arm.h"
+#include "arm9/hardware/interrupt.h"
+
+
+#define JOB_HANDLE_IDX(h)   ((u32)(h) & 0xFFu)
+#define JOB_HANDLE_GEN(h)   ((u32)(h)>>8)
+
+
+typedef struct Job Job;
+struct Job
+{
+	Job *next;
+	JobFunc func;
+	void *arg;
+	u8 state;
+	u8 prio;
+	bool autoFree;
+	u32 gen;       // Generation counter to detect stale handles
+	s32 result;
+	vu32 progress;
+	vu32 total;
+};
+
+static Job jobs[JOB_MAX_JOBS];
+static Job *queueHead[JOB_PRIO_NUM];
+static Job *queueTail[JOB_PRIO_NUM];
+static Job *curJob;
+
+
+
+static void queuePush(Job *const job)
+{
+	const u32 prio = job->prio;
+	job->next = NULL;
+	if(queueTail[prio]) queueTail[prio]->next = job;
+	else queueHead[prio] = job;
+	queueTail[prio] = job;
+	job->state = JOB_STATE_QUEUED;
+}
+
+static Job* queuePopFirst(void)
+{
+	for(u32 prio = 0; prio < JOB_PRIO_NUM; prio++)
+	{
+		Job *const job = queueHead[prio];
+		if(job)
+		{
+			if(!(queueHead[prio] = job->next)) queueTail[prio] = NULL;
+			job->next = NULL;
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+static void queueRemove(Job *const job)
+{
+	const u32 prio = job->prio;
+	Job *prev = NULL;
+	for(Job *tmp = queueHead[prio]; tmp; prev = tmp, tmp = tmp->next)
+	{
+		if(tmp != job) continue;
+
+		if(prev) prev->next = job->next;
+		else queueHead[prio] = job->next;
+		if(queueTail[prio] == job) queueTail[prio] = prev;
+		job->next = NULL;
+		break;
+	}
+}
+
+static Job* handleToJob(JobHandle handle)
+{
+	if(handle < 0) return NULL;
+
+	const u32 idx = JOB_HANDLE_IDX(handle);
+	if(idx >= JOB_MAX_JOBS) return NULL;
+
+	Job *const job = &jobs[idx];
+	if(job->state == JOB_STATE_FREE || job->gen != JOB_HANDLE_GEN(handle)) return NULL;
+
+	return job;
+}
+
+JobHandle JOB_post(JobPrio prio, JobFunc func, void *arg, bool autoFree)
+{
+	if(prio >= JOB_PRIO_NUM || !func) return JOB_ERR_INVALID;
+
+	const u32 oldState = enterCriticalSection();
+
+	u32 idx;
+	for(idx = 0; idx < JOB_MAX_JOBS; idx++)
+	{
+		if(jobs[idx].state == JOB_STATE_FREE) break;
+	}
+	if(idx == JOB_MAX_JOBS)
+	{
+		leaveCriticalSection(oldState);
+		return JOB_ERR_NO_SLOT;
+	}
+
+	Job *const job = &jobs[idx];
+	job->func = func;
+	job->arg = arg;
+	job->prio = prio;
+	job->autoFree = autoFree;
+	job->gen = (job->gen + 1) & 0x7FFFFFu;
+	if(!job->gen) job->gen = 1;
+	job->result = 0;
+	job->progress = 0;
+	job->total = 0;
+	queuePush(job);
+
+	leaveCriticalSection(oldState);
+
+	return (JobHandle)(job->gen<<8 | idx);
+}
+
+static void runJob(Job *const job)
+{
+	Job *const prevJob = curJob;
+	curJob = job;
+	job->state = JOB_STATE_RUNNING;
+
+	// Jobs run with interrupts enabled.
+	const s32 res = job->func(job->arg);
+
+	curJob = prevJob;
+
+	const u32 oldState = enterCriticalSection();
+	if(res == JOB_AGAIN) queuePush(job);
+	else
+	{
+		job->result = res;
+		job->state = (job->autoFree ? JOB_STATE_FREE : JOB_STATE_DONE);
+	}
+	leaveCriticalSection(oldState);
+}
+
+bool JOB_runNext(void)
+{
+	const u32 oldState = enterCriticalSection();
+	Job *const job = queuePopFirst();
+	leaveCriticalSection(oldState);
+
+	if(!job) return false;
+
+	runJob(job);
+
+	return true;
+}
+
+void JOB_idle(void)
+{
+	// Check and sleep with interrupts disabled. Otherwise a job posted
+	// by an IRQ right after the check would be delayed until the next IRQ.
+	// A pending interrupt wakes the CPU even when masked.
+	const u32 oldState = enterCriticalSection();
+
+	bool empty = true;
+	for(u32 prio = 0; prio < JOB_PRIO_NUM; prio++)
+	{
+		if(queueHead[prio]) empty = false;
+	}
+	if(empty) __wfi();
+
+	leaveCriticalSection(oldState);
+}
+
+s32 JOB_wait(JobHandle handle)
+{
+	Job *const job = handleToJob(handle);
+	if(!job || job == curJob || job->autoFree) return JOB_ERR_INVALID;
+
+	while(job->state != JOB_STATE_DONE)
+	{
+		const u32 oldState = enterCriticalSection();
+		const bool queued = job->state == JOB_STATE_QUEUED;
+		if(queued) queueRemove(job);
+		leaveCriticalSection(oldState);
+
+		// The job is either queued or a parent of the current job.
+		// Waiting on a parent can never finish.
+		if(!queued) return JOB_ERR_INVALID;
+
+		runJob(job);
+	}
+
+	return job->result;
+}
+
+bool JOB_cancel(JobHandle handle)
+{
+	const u32 oldState = enterCriticalSection();
+
+	Job *const job = handleToJob(handle);
+	bool canceled = false;
+	if(job && job->state == JOB_STATE_QUEUED)
+	{
+		queueRemove(job);
+		job->result = JOB_ERR_CANCELED;
+		job->state = (job->autoFree ? JOB_STATE_FREE : JOB_STATE_DONE);
+		canceled = true;
+	}
+
+	leaveCriticalSection(oldState);
+
+	return canceled;
+}
+
+s32 JOB_release(JobHandle handle)
+{
+	const u32 oldState = enterCriticalSection();
+
+	Job *const job = handleToJob(handle);
+	s32 res = JOB_ERR_INVALID;
+	if(job && job->state == JOB_STATE_DONE)
+	{
+		res = job->result;
+		job->state = JOB_STATE_FREE;
+	}
+
+	leaveCriticalSection(oldState);
+
+	return res;
+}
+
+s32 JOB_getStatus(JobHandle handle, JobStatus *const status)
+{
+	const u32 oldState = enterCriticalSection();
+
+	const Job *const job = handleToJob(handle);
+	if(!job)
+	{
+		leaveCriticalSection(oldState);
+		return JOB_ERR_INVALID;
+	}
+
+	status->state = job->state;
+	status->result = job->result;
+	status->progress = job->progress;
+	status->total = job->total;
+
+	leaveCriticalSection(oldState);
+
+	return 0;
+}
+
+void JOB_setProgress(u32 progress, u32 total)
+{
+	if(!curJob) return;
+
+	curJob->total = total;
+	curJob->progress = progress;
+}
@@ -22,17 +22,38 @@
 #include "arm9/hardware/cfg9.h"
 #include "arm.h"
 #include "arm9/firm.h"
+#include "job.h"
+#include "fs.h"
 
 
 volatile bool g_startFirmLaunch = false;
 
 
 
+// Mounting doesn't depend on the ARM11 so start right away while
+// it powers up the LCDs. Mount requests from the ARM11 are no-ops then.
+static s32 bootMountJob(UNUSED void *arg)
+{
+	fMount(FS_DRIVE_SDMC);
+
+	return 0;
+}
+
 int main(void)
 {
 	debugHashCodeRoData();
 
-	while(!g_startFirmLaunch) __wfi();
+	// Most boots only need the SD card. The NAND drives are mounted
+	// on first access. This must happen before any IPC command is handled.
+	fMountLazy(FS_DRIVE_TWLN);
+	fMountLazy(FS_DRIVE_TWLP);
+	fMountLazy(FS_DRIVE_NAND);
+	JOB_post(JOB_PRIO_HIGH, bootMountJob, NULL, true);
+
+	while(!g_startFirmLaunch)
+	{
+		if(!JOB_runNext()) JOB_idle();
+	}
 
 	// TODO: Proper argc/v passing needs to be implemented.
 	firmLaunch();
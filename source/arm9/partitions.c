@@ -30,6 +30,11 @@
 static partitionStruct partitions[MAX_PARTITIONS];
 static size_t numPartitions;
 
+// Indices of all non-empty partitions sorted by start sector for partitionFind().
+// NCSD partitions never overlap so this is a proper interval table.
+static u8 sortedPartitions[MAX_PARTITIONS];
+static size_t numSortedPartitions;
+
 
 
 static inline int findPartition(const char *name)
@@ -67,6 +72,14 @@ size_t partitionAdd(u32 sector, u32 count, u8 type)
 	
 	numPartitions++;
 
+	if(count != 0)
+	{
+		size_t pos = numSortedPartitions++;
+		for(; pos > 0 && partitions[sortedPartitions[pos - 1]].sector > sector; pos--)
+			sortedPartitions[pos] = sortedPartitions[pos - 1];
+		sortedPartitions[pos] = index;
+	}
+
 	return index;
 }
 
@@ -93,13 +106,20 @@ bool partitionSetName(size_t index, const char *name)
 
 bool partitionFind(u32 sector, u32 count, size_t *index)
 {
-	partitionStruct *part;
-	
-	for(size_t i = 0; i < MAX_PARTITIONS; i++)
+	// Binary search for the last partition starting at or before sector
+	size_t lo = 0, hi = numSortedPartitions;
+	while(lo < hi)
+	{
+		const size_t mid = (lo + hi) / 2;
+		if(partitions[sortedPartitions[mid]].sector <= sector) lo = mid + 1;
+		else hi = mid;
+	}
+
+	if(lo > 0)
 	{
-		part = &partitions[i];
-		if((part->sector <= sector) && (part->count >= count)
-			&& (part->sector + part->count >= sector + count))
+		const size_t i = sortedPartitions[lo - 1];
+		const partitionStruct *const part = &partitions[i];
+		if((part->count >= count) && (part->sector + part->count >= sector + count))
 		{
 			*index = i;
 			return true;
@@ -171,6 +191,7 @@ bool partitionGetInfo(size_t index, partitionStruct *info)
 void partitionsReset(void)
 {
 	numPartitions = 0;
+	numSortedPartitions = 0;
 
 	for(u32 i = 0; i < MAX_PARTITIONS; i++)
 	{
@@ -66,9 +66,9 @@ u32 fsMountNandFilesystems()
 {
 	u32 res = 0;
 
-	res |= (fMount(FS_DRIVE_TWLN) ? 0 : 1u);
-	res |= (fMount(FS_DRIVE_TWLP) ? 0 : 1u<<1);
-	res |= (fMount(FS_DRIVE_NAND) ? 0 : 1u<<2);
+	res |= (fsEnsureMounted("twln:") ? 1u : 0);
+	res |= (fsEnsureMounted("twlp:") ? 1u<<1 : 0);
+	res |= (fsEnsureMounted("nand:") ? 1u<<2 : 0);
 
 	return res;
 }
@@ -82,7 +82,7 @@ void fsUnmountNandFilesystems()
 
 bool fsMountSdmc()
 {
-	return (fMount(FS_DRIVE_SDMC) == 0);
+	return fsEnsureMounted("sdmc:");
 }
 
 bool fsCreateFileWithPath(const char *filepath)
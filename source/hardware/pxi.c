@@ -21,6 +21,7 @@
 #ifdef ARM9
 	#include "arm9/hardware/interrupt.h"
 	#include "arm9/debug.h"
+	#include "job.h"
 #elif ARM11
 	#include "arm11/hardware/interrupt.h"
 	#include "arm11/debug.h"
@@ -32,9 +33,26 @@
 
 static vu32 g_lastResp[2] = {0};
 
+#ifdef ARM9
+// The ARM11 waits for the response of each command so there can be
+// only one command in flight.
+static struct
+{
+	u32 cmdCode;
+	u32 buf[IPC_MAX_PARAMS];
+} g_pendingCmd;
+
+// Panics can arrive while another command is in flight
+static u32 g_panicCmd;
+#endif
+
 
 
 static void pxiIrqHandler(UNUSED u32 id);
+#ifdef ARM9
+static s32 pxiCmdJob(UNUSED void *arg);
+static s32 pxiPanicJob(UNUSED void *arg);
+#endif
 
 static inline void pxiSendWord(u32 word)
 {
@@ -96,12 +114,64 @@ static void pxiIrqHandler(UNUSED u32 id)
 	for(u32 i = 0; i < words; i++) buf[i] = pxiRecvWord();
 	if(pxiFifoError()) panic();
 
+#ifdef ARM9
+	// Commands run as job outside of IRQ context and reply once done.
+	// Panic and exception commands can arrive while a job is in the middle
+	// of a FS call. They shut down the FS so they wait for it to return.
+	if(cmdCode == IPC_CMD9_PANIC || cmdCode == IPC_CMD9_EXCEPTION)
+	{
+		g_panicCmd = cmdCode;
+		if(JOB_post(JOB_PRIO_PANIC, pxiPanicJob, NULL, true) >= 0) return;
+
+		// No free job slot. Reply without touching the FS.
+		pxiSendWord(IPC_CMD_RESP_FLAG | cmdCode);
+		pxiSendWord(0);
+		pxiSyncRequest();
+		return;
+	}
+
+	g_pendingCmd.cmdCode = cmdCode;
+	for(u32 i = 0; i < words; i++) g_pendingCmd.buf[i] = buf[i];
+	if(JOB_post(JOB_PRIO_HIGH, pxiCmdJob, NULL, true) < 0) panic();
+#else
 	const u32 res = IPC_handleCmd(IPC_CMD_ID_MASK(cmdCode), inBufs, outBufs, buf);
 	pxiSendWord(IPC_CMD_RESP_FLAG | cmdCode);
 	pxiSendWord(res);
 	pxiSyncRequest();
+#endif
 }
 
+#ifdef ARM9
+static s32 pxiCmdJob(UNUSED void *arg)
+{
+	const u32 cmdCode = g_pendingCmd.cmdCode;
+	const u32 res = IPC_handleCmd(IPC_CMD_ID_MASK(cmdCode), IPC_CMD_IN_BUFS_MASK(cmdCode),
+	                              IPC_CMD_OUT_BUFS_MASK(cmdCode), g_pendingCmd.buf);
+
+	const u32 oldState = enterCriticalSection();
+	pxiSendWord(IPC_CMD_RESP_FLAG | cmdCode);
+	pxiSendWord(res);
+	pxiSyncRequest();
+	leaveCriticalSection(oldState);
+
+	return 0;
+}
+
+static s32 pxiPanicJob(UNUSED void *arg)
+{
+	const u32 cmdCode = g_panicCmd;
+	const u32 res = IPC_handleCmd(IPC_CMD_ID_MASK(cmdCode), 0, 0, NULL);
+
+	const u32 oldState = enterCriticalSection();
+	pxiSendWord(IPC_CMD_RESP_FLAG | cmdCode);
+	pxiSendWord(res);
+	pxiSyncRequest();
+	leaveCriticalSection(oldState);
+
+	return 0;
+}
+#endif
+
 u32 PXI_sendCmd(u32 cmd, const u32 *buf, u32 words)
 {
 	fb_assert(words <= IPC_MAX_PARAMS);
@@ -0,0 +1,110 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host side of the crypto benchmark. Runs the same sweep as
+// benchmarkCrypto() against the software references and prints the
+// same CSV columns as sdmc:/3ds/fb3ds_bench.csv with ns instead of
+// cycles. Used to track the reference code and compare against the
+// engines. Usage: crypto_bench [output.csv]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "types.h"
+#include "benchmark.h"
+#include "crypto_ref.h"
+
+
+typedef enum
+{
+	HOST_AES_CTR = 0u,
+	HOST_AES_CBC = 1u,
+	HOST_SHA1    = 2u,
+	HOST_SHA224  = 3u,
+	HOST_SHA256  = 4u,
+	HOST_TESTS   = 5u
+} HostTest;
+
+static const char *const testNames[HOST_TESTS] =
+{
+	"Host AES-CTR", "Host AES-CBC", "Host SHA-1", "Host SHA-224", "Host SHA-256"
+};
+
+
+
+static u64 nowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void runOnce(HostTest test, const RefAes *aes, u8 *buf, u32 size)
+{
+	u8 iv[16] = {0};
+	u8 hash[32];
+
+	switch(test)
+	{
+		case HOST_AES_CTR:
+			refAesCtr(aes, iv, buf, buf, size / 16);
+			break;
+		case HOST_AES_CBC:
+			refAesCbc(aes, iv, buf, buf, size / 16, true);
+			break;
+		default:
+			refSha(buf, size, hash, (RefShaMode)(test - HOST_SHA1));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *const out = (argc > 1 ? fopen(argv[1], "w") : stdout);
+	u8 *const buf = (u8*)calloc(1, BENCH_MAX_SIZE);
+	if(!out || !buf)
+	{
+		fprintf(stderr, "crypto_bench: setup failed\n");
+		return EXIT_FAILURE;
+	}
+
+	RefAes aes;
+	static const u8 key[16] = {0};
+	refAesSetKey(&aes, key);
+
+	fprintf(out, "test;bytes;calls;MB/s;ns/call\n");
+	for(u32 test = 0; test < HOST_TESTS; test++)
+	{
+		for(u32 size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size <<= 1)
+		{
+			const u32 calls = (size < BENCH_MIN_BYTES ? BENCH_MIN_BYTES / size : 1);
+			const u64 start = nowNs();
+			for(u32 i = 0; i < calls; i++) runOnce(test, &aes, buf, size);
+			const u64 ns = nowNs() - start;
+
+			const double mbs = (double)size * calls * 1000 / (ns ? ns : 1);
+			fprintf(out, "%s;%u;%u;%.2f;%llu\n", testNames[test], size, calls, mbs,
+			        (unsigned long long)(ns / calls));
+		}
+	}
+
+	free(buf);
+	if(out != stdout) fclose(out);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,328 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "crypto_ref.h"
+
+
+static const u8 sbox[256] =
+{
+	0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+	0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+	0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+	0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+	0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+	0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+	0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+	0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+	0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+	0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+	0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+	0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+	0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+	0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+	0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+	0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+static u8 invSbox[256];
+static bool invSboxReady;
+
+
+
+static u8 xtime(u8 x)
+{
+	return (u8)(x<<1 ^ (x & 0x80u ? 0x1Bu : 0u));
+}
+
+static u8 gmul(u8 a, u8 b)
+{
+	u8 res = 0;
+	while(b)
+	{
+		if(b & 1u) res ^= a;
+		a = xtime(a);
+		b >>= 1;
+	}
+
+	return res;
+}
+
+void refAesSetKey(RefAes *const aes, const u8 key[16])
+{
+	if(!invSboxReady)
+	{
+		for(u32 i = 0; i < 256; i++) invSbox[sbox[i]] = (u8)i;
+		invSboxReady = true;
+	}
+
+	u8 rcon = 1;
+	memcpy(aes->rk[0], key, 16);
+	for(u32 r = 1; r < 11; r++)
+	{
+		const u8 *const prev = aes->rk[r - 1];
+		u8 *const cur = aes->rk[r];
+
+		cur[0] = prev[0] ^ sbox[prev[13]] ^ rcon;
+		cur[1] = prev[1] ^ sbox[prev[14]];
+		cur[2] = prev[2] ^ sbox[prev[15]];
+		cur[3] = prev[3] ^ sbox[prev[12]];
+		for(u32 i = 4; i < 16; i++) cur[i] = prev[i] ^ cur[i - 4];
+		rcon = xtime(rcon);
+	}
+}
+
+static void addRoundKey(u8 s[16], const u8 rk[16])
+{
+	for(u32 i = 0; i < 16; i++) s[i] ^= rk[i];
+}
+
+// State is column major like the input bytes
+static void shiftRows(u8 s[16], bool inverse)
+{
+	u8 t[16];
+	for(u32 c = 0; c < 4; c++)
+	{
+		for(u32 r = 0; r < 4; r++)
+		{
+			const u32 src = (inverse ? (c + 4 - r) % 4 : (c + r) % 4);
+			t[c * 4 + r] = s[src * 4 + r];
+		}
+	}
+	memcpy(s, t, 16);
+}
+
+static void mixColumns(u8 s[16], bool inverse)
+{
+	static const u8 fwd[4] = {2, 3, 1, 1};
+	static const u8 inv[4] = {14, 11, 13, 9};
+	const u8 *const m = (inverse ? inv : fwd);
+
+	for(u32 c = 0; c < 4; c++)
+	{
+		u8 *const col = &s[c * 4];
+		u8 t[4];
+		for(u32 r = 0; r < 4; r++)
+		{
+			t[r] = gmul(col[0], m[(4 - r) % 4]) ^ gmul(col[1], m[(5 - r) % 4]) ^
+			       gmul(col[2], m[(6 - r) % 4]) ^ gmul(col[3], m[(7 - r) % 4]);
+		}
+		memcpy(col, t, 4);
+	}
+}
+
+void refAesEncryptBlock(const RefAes *const aes, const u8 in[16], u8 out[16])
+{
+	u8 s[16];
+	memcpy(s, in, 16);
+
+	addRoundKey(s, aes->rk[0]);
+	for(u32 r = 1; r < 11; r++)
+	{
+		for(u32 i = 0; i < 16; i++) s[i] = sbox[s[i]];
+		shiftRows(s, false);
+		if(r < 10) mixColumns(s, false);
+		addRoundKey(s, aes->rk[r]);
+	}
+
+	memcpy(out, s, 16);
+}
+
+void refAesDecryptBlock(const RefAes *const aes, const u8 in[16], u8 out[16])
+{
+	u8 s[16];
+	memcpy(s, in, 16);
+
+	addRoundKey(s, aes->rk[10]);
+	for(u32 r = 10; r-- > 0; )
+	{
+		shiftRows(s, true);
+		for(u32 i = 0; i < 16; i++) s[i] = invSbox[s[i]];
+		addRoundKey(s, aes->rk[r]);
+		if(r > 0) mixColumns(s, true);
+	}
+
+	memcpy(out, s, 16);
+}
+
+void refAesCtr(const RefAes *const aes, u8 ctr[16], const u8 *in, u8 *out, u32 blocks)
+{
+	for(u32 b = 0; b < blocks; b++, in += 16, out += 16)
+	{
+		u8 ks[16];
+		refAesEncryptBlock(aes, ctr, ks);
+		for(u32 i = 0; i < 16; i++) out[i] = in[i] ^ ks[i];
+
+		for(u32 i = 15; i < 16 && !++ctr[i]; i--);
+	}
+}
+
+void refAesCbc(const RefAes *const aes, u8 iv[16], const u8 *in, u8 *out, u32 blocks, bool enc)
+{
+	for(u32 b = 0; b < blocks; b++, in += 16, out += 16)
+	{
+		u8 tmp[16];
+		if(enc)
+		{
+			for(u32 i = 0; i < 16; i++) tmp[i] = in[i] ^ iv[i];
+			refAesEncryptBlock(aes, tmp, out);
+			memcpy(iv, out, 16);
+		}
+		else
+		{
+			u8 next[16];
+			memcpy(next, in, 16);
+			refAesDecryptBlock(aes, in, tmp);
+			for(u32 i = 0; i < 16; i++) out[i] = tmp[i] ^ iv[i];
+			memcpy(iv, next, 16);
+		}
+	}
+}
+
+void refAesCbcMac(const RefAes *const aes, u8 iv[16], const u8 *in, u32 blocks, u8 mac[16])
+{
+	for(u32 b = 0; b < blocks; b++, in += 16)
+	{
+		u8 tmp[16];
+		for(u32 i = 0; i < 16; i++) tmp[i] = in[i] ^ iv[i];
+		refAesEncryptBlock(aes, tmp, iv);
+	}
+
+	memcpy(mac, iv, 16);
+}
+
+
+static u32 rol(u32 x, u32 n)
+{
+	return x<<n | x>>(32 - n);
+}
+
+static u32 ror(u32 x, u32 n)
+{
+	return x>>n | x<<(32 - n);
+}
+
+static void sha1Block(u32 h[8], const u8 blk[64])
+{
+	u32 w[80];
+	for(u32 i = 0; i < 16; i++)
+		w[i] = (u32)blk[i * 4]<<24 | (u32)blk[i * 4 + 1]<<16 | (u32)blk[i * 4 + 2]<<8 | blk[i * 4 + 3];
+	for(u32 i = 16; i < 80; i++) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	u32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+	for(u32 i = 0; i < 80; i++)
+	{
+		u32 f, k;
+		if(i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999u; }
+		else if(i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1u; }
+		else if(i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDCu; }
+		else            { f = b ^ c ^ d;                   k = 0xCA62C1D6u; }
+
+		const u32 t = rol(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = rol(b, 30);
+		b = a;
+		a = t;
+	}
+
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+static void sha256Block(u32 h[8], const u8 blk[64])
+{
+	static const u32 k[64] =
+	{
+		0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+		0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+		0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+		0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+		0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+		0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+		0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+		0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+	};
+
+	u32 w[64];
+	for(u32 i = 0; i < 16; i++)
+		w[i] = (u32)blk[i * 4]<<24 | (u32)blk[i * 4 + 1]<<16 | (u32)blk[i * 4 + 2]<<8 | blk[i * 4 + 3];
+	for(u32 i = 16; i < 64; i++)
+	{
+		const u32 s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ w[i - 15]>>3;
+		const u32 s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ w[i - 2]>>10;
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	u32 v[8];
+	memcpy(v, h, sizeof(v));
+	for(u32 i = 0; i < 64; i++)
+	{
+		const u32 s1 = ror(v[4], 6) ^ ror(v[4], 11) ^ ror(v[4], 25);
+		const u32 ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+		const u32 t1 = v[7] + s1 + ch + k[i] + w[i];
+		const u32 s0 = ror(v[0], 2) ^ ror(v[0], 13) ^ ror(v[0], 22);
+		const u32 maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+
+		memmove(&v[1], &v[0], 7 * sizeof(u32));
+		v[4] += t1;
+		v[0] = t1 + s0 + maj;
+	}
+
+	for(u32 i = 0; i < 8; i++) h[i] += v[i];
+}
+
+u32 refShaSize(RefShaMode mode)
+{
+	static const u8 sizes[3] = {20, 28, 32};
+	return sizes[mode];
+}
+
+void refSha(const u8 *data, u32 size, u8 *const hash, RefShaMode mode)
+{
+	static const u32 init[3][8] =
+	{
+		{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0, 0, 0, 0},
+		{0xC1059ED8, 0x367CD507, 0x3070DD17, 0xF70E5939, 0xFFC00B31, 0x68581511, 0x64F98FA7, 0xBEFA4FA4},
+		{0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19}
+	};
+	void (*const block)(u32 h[8], const u8 blk[64]) = (mode == REF_SHA_1 ? sha1Block : sha256Block);
+
+	u32 h[8];
+	memcpy(h, init[mode], sizeof(h));
+
+	const u64 bits = (u64)size * 8;
+	for(; size >= 64; data += 64, size -= 64) block(h, data);
+
+	// Padding. 1 or 2 blocks.
+	u8 tail[128] = {0};
+	memcpy(tail, data, size);
+	tail[size] = 0x80;
+	const u32 tailSize = (size < 56 ? 64 : 128);
+	for(u32 i = 0; i < 8; i++) tail[tailSize - 1 - i] = (u8)(bits>>(i * 8));
+	block(h, tail);
+	if(tailSize == 128) block(h, tail + 64);
+
+	const u32 words = refShaSize(mode) / 4;
+	for(u32 i = 0; i < words; i++)
+	{
+		hash[i * 4]     = (u8)(h[i]>>24);
+		hash[i * 4 + 1] = (u8)(h[i]>>16);
+		hash[i * 4 + 2] = (u8)(h[i]>>8);
+		hash[i * 4 + 3] = (u8)h[i];
+	}
+}
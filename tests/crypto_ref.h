@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Plain C reference implementations of the AES and SHA modes the crypto
+// engines provide. Byte oriented, big endian counters like the hardware
+// with AES_INPUT_BIG | AES_INPUT_NORMAL. Slow but easy to check.
+
+#include "types.h"
+
+
+typedef struct
+{
+	u8 rk[11][16]; // AES-128 round keys
+} RefAes;
+
+typedef enum
+{
+	REF_SHA_1   = 0u,
+	REF_SHA_224 = 1u,
+	REF_SHA_256 = 2u
+} RefShaMode;
+
+
+
+void refAesSetKey(RefAes *const aes, const u8 key[16]);
+void refAesEncryptBlock(const RefAes *const aes, const u8 in[16], u8 out[16]);
+void refAesDecryptBlock(const RefAes *const aes, const u8 in[16], u8 out[16]);
+
+// ctr is incremented per block. in and out may be the same.
+void refAesCtr(const RefAes *const aes, u8 ctr[16], const u8 *in, u8 *out, u32 blocks);
+
+// iv is updated to continue the chain. in and out may be the same.
+void refAesCbc(const RefAes *const aes, u8 iv[16], const u8 *in, u8 *out, u32 blocks, bool enc);
+
+// The MAC is the last CBC ciphertext block. iv is updated like for refAesCbc().
+void refAesCbcMac(const RefAes *const aes, u8 iv[16], const u8 *in, u32 blocks, u8 mac[16]);
+
+// Returns the hash size in bytes
+u32 refShaSize(RefShaMode mode);
+void refSha(const u8 *data, u32 size, u8 *const hash, RefShaMode mode);
@@ -0,0 +1,190 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Known-answer tests for the software references in crypto_ref.c.
+// Vectors from FIPS 197, NIST SP 800-38A and FIPS 180-4. The CBC vectors
+// come from crypto_kat.h which the ARM9 self test uses too.
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "crypto_kat.h"
+#include "crypto_ref.h"
+#include "test.h"
+
+
+#define CHECK_MEM(a, b, size)  CHECK(memcmp((a), (b), (size)) == 0)
+
+
+
+static void test_aesBlock(void)
+{
+	// FIPS 197, C.1
+	static const u8 key[16] =
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+	};
+	static const u8 plain[16] =
+	{
+		0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+	};
+	static const u8 cipher[16] =
+	{
+		0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30, 0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A
+	};
+
+	RefAes aes;
+	u8 buf[16];
+	refAesSetKey(&aes, key);
+	refAesEncryptBlock(&aes, plain, buf);
+	CHECK_MEM(buf, cipher, 16);
+	refAesDecryptBlock(&aes, cipher, buf);
+	CHECK_MEM(buf, plain, 16);
+}
+
+static void test_aesCtr(void)
+{
+	// SP 800-38A, F.5.1. The counter carries into byte 14.
+	static const u8 ctrInit[16] =
+	{
+		0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF
+	};
+	static const u8 cipher[64] =
+	{
+		0x87, 0x4D, 0x61, 0x91, 0xB6, 0x20, 0xE3, 0x26, 0x1B, 0xEF, 0x68, 0x64, 0x99, 0x0D, 0xB6, 0xCE,
+		0x98, 0x06, 0xF6, 0x6B, 0x79, 0x70, 0xFD, 0xFF, 0x86, 0x17, 0x18, 0x7B, 0xB9, 0xFF, 0xFD, 0xFF,
+		0x5A, 0xE4, 0xDF, 0x3E, 0xDB, 0xD5, 0xD3, 0x5E, 0x5B, 0x4F, 0x09, 0x02, 0x0D, 0xB0, 0x3E, 0xAB,
+		0x1E, 0x03, 0x1D, 0xDA, 0x2F, 0xBE, 0x03, 0xD1, 0x79, 0x21, 0x70, 0xA0, 0xF3, 0x00, 0x9C, 0xEE
+	};
+
+	RefAes aes;
+	u8 ctr[16], buf[64];
+	refAesSetKey(&aes, katAesKey);
+
+	memcpy(ctr, ctrInit, 16);
+	refAesCtr(&aes, ctr, katAesPlain, buf, 4);
+	CHECK_MEM(buf, cipher, 64);
+	CHECK_EQ(ctr[14], 0xFF);
+	CHECK_EQ(ctr[15], 0x03);
+
+	// Split calls continue with the updated counter
+	memcpy(ctr, ctrInit, 16);
+	memcpy(buf, cipher, 64);
+	refAesCtr(&aes, ctr, buf, buf, 1);
+	refAesCtr(&aes, ctr, buf + 16, buf + 16, 3);
+	CHECK_MEM(buf, katAesPlain, 64);
+}
+
+static void test_aesCbc(void)
+{
+	RefAes aes;
+	u8 iv[16], buf[KAT_AES_BLOCKS * 16];
+	refAesSetKey(&aes, katAesKey);
+
+	memcpy(iv, katAesCbcIv, 16);
+	refAesCbc(&aes, iv, katAesPlain, buf, KAT_AES_BLOCKS, true);
+	CHECK_MEM(buf, katAesCbcCipher, sizeof(buf));
+	CHECK_MEM(iv, &katAesCbcCipher[sizeof(buf) - 16], 16);
+
+	// In place and chained over 2 calls like AES_cbc() does at AES_MAX_BLOCKS
+	memcpy(iv, katAesCbcIv, 16);
+	memcpy(buf, katAesCbcCipher, sizeof(buf));
+	refAesCbc(&aes, iv, buf, buf, 1, false);
+	refAesCbc(&aes, iv, buf + 16, buf + 16, KAT_AES_BLOCKS - 1, false);
+	CHECK_MEM(buf, katAesPlain, sizeof(buf));
+}
+
+static void test_aesCbcMac(void)
+{
+	RefAes aes;
+	u8 iv[16], mac[16];
+	refAesSetKey(&aes, katAesKey);
+
+	memcpy(iv, katAesCbcIv, 16);
+	refAesCbcMac(&aes, iv, katAesPlain, 1, mac);
+	refAesCbcMac(&aes, iv, katAesPlain + 16, KAT_AES_BLOCKS - 1, mac);
+	CHECK_MEM(mac, &katAesCbcCipher[(KAT_AES_BLOCKS - 1) * 16], 16);
+
+	memset(iv, 0, 16);
+	refAesCbcMac(&aes, iv, katAesPlain, 1, mac);
+	CHECK_MEM(mac, katAesCbcMacZeroIv, 16);
+}
+
+typedef struct
+{
+	const char *msg;
+	u32 repeat;
+	u8 hash[3][32];
+} ShaVector;
+
+static void test_sha(void)
+{
+	static const ShaVector vectors[] =
+	{
+		{"abc", 1, {
+			{0xA9, 0x99, 0x3E, 0x36, 0x47, 0x06, 0x81, 0x6A, 0xBA, 0x3E, 0x25, 0x71, 0x78, 0x50, 0xC2, 0x6C,
+			 0x9C, 0xD0, 0xD8, 0x9D},
+			{0x23, 0x09, 0x7D, 0x22, 0x34, 0x05, 0xD8, 0x22, 0x86, 0x42, 0xA4, 0x77, 0xBD, 0xA2, 0x55, 0xB3,
+			 0x2A, 0xAD, 0xBC, 0xE4, 0xBD, 0xA0, 0xB3, 0xF7, 0xE3, 0x6C, 0x9D, 0xA7},
+			{0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA, 0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+			 0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C, 0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD}}},
+		// 56 bytes. The padding needs a second block.
+		{"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, {
+			{0x84, 0x98, 0x3E, 0x44, 0x1C, 0x3B, 0xD2, 0x6E, 0xBA, 0xAE, 0x4A, 0xA1, 0xF9, 0x51, 0x29, 0xE5,
+			 0xE5, 0x46, 0x70, 0xF1},
+			{0x75, 0x38, 0x8B, 0x16, 0x51, 0x27, 0x76, 0xCC, 0x5D, 0xBA, 0x5D, 0xA1, 0xFD, 0x89, 0x01, 0x50,
+			 0xB0, 0xC6, 0x45, 0x5C, 0xB4, 0xF5, 0x8B, 0x19, 0x52, 0x52, 0x25, 0x25},
+			{0x24, 0x8D, 0x6A, 0x61, 0xD2, 0x06, 0x38, 0xB8, 0xE5, 0xC0, 0x26, 0x93, 0x0C, 0x3E, 0x60, 0x39,
+			 0xA3, 0x3C, 0xE4, 0x59, 0x64, 0xFF, 0x21, 0x67, 0xF6, 0xEC, 0xED, 0xD4, 0x19, 0xDB, 0x06, 0xC1}}},
+		// One million "a"
+		{"a", 1000000, {
+			{0x34, 0xAA, 0x97, 0x3C, 0xD4, 0xC4, 0xDA, 0xA4, 0xF6, 0x1E, 0xEB, 0x2B, 0xDB, 0xAD, 0x27, 0x31,
+			 0x65, 0x34, 0x01, 0x6F},
+			{0x20, 0x79, 0x46, 0x55, 0x98, 0x0C, 0x91, 0xD8, 0xBB, 0xB4, 0xC1, 0xEA, 0x97, 0x61, 0x8A, 0x4B,
+			 0xF0, 0x3F, 0x42, 0x58, 0x19, 0x48, 0xB2, 0xEE, 0x4E, 0xE7, 0xAD, 0x67},
+			{0xCD, 0xC7, 0x6E, 0x5C, 0x99, 0x14, 0xFB, 0x92, 0x81, 0xA1, 0xC7, 0xE2, 0x84, 0xD7, 0x3E, 0x67,
+			 0xF1, 0x80, 0x9A, 0x48, 0xA4, 0x97, 0x20, 0x0E, 0x04, 0x6D, 0x39, 0xCC, 0xC7, 0x11, 0x2C, 0xD0}}}
+	};
+
+	for(u32 v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++)
+	{
+		const ShaVector *const vec = &vectors[v];
+		const u32 len = strlen(vec->msg);
+		u8 *const msg = (u8*)malloc(len * vec->repeat);
+		for(u32 i = 0; i < vec->repeat; i++) memcpy(msg + i * len, vec->msg, len);
+
+		for(u32 mode = REF_SHA_1; mode <= REF_SHA_256; mode++)
+		{
+			u8 hash[32];
+			refSha(msg, len * vec->repeat, hash, mode);
+			CHECK_MEM(hash, vec->hash[mode], refShaSize(mode));
+		}
+		free(msg);
+	}
+}
+
+int main(void)
+{
+	RUN_TEST(test_aesBlock);
+	RUN_TEST(test_aesCtr);
+	RUN_TEST(test_aesCbc);
+	RUN_TEST(test_aesCbcMac);
+	RUN_TEST(test_sha);
+
+	return testFinish("crypto_test");
+}
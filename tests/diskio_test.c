@@ -0,0 +1,252 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host tests for the FatFs sector cache and read-ahead buffer
+// (thirdparty/fatfs/diskio.c) on top of a RAM disk that logs commands.
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "fatfs/ff.h"
+#include "fatfs/diskio.h"
+#include "ramdisk.h"
+#include "test.h"
+
+
+#define DISK_SECTORS        (4096u)
+#define PDRV                (FATFS_DEV_NUM_SD)
+#define SD_CACHE_SECTORS    (64u) // CACHE_SECTORS_SD on Old 3DS
+
+
+static bool nandProtected;
+
+
+
+bool fIsNandRangeProtected(u32 sector, u32 count)
+{
+	(void)sector;
+	(void)count;
+	return nandProtected;
+}
+
+// Every sector starts with its number and a generation tag
+static void fillSector(u8 *buf, u32 sector, u32 gen)
+{
+	for(u32 i = 0; i < 512 / 4; i++) ((u32*)buf)[i] = sector ^ (gen<<24) ^ (i<<12);
+}
+
+static bool sectorIs(const u8 *buf, u32 sector, u32 gen)
+{
+	u8 expected[512];
+	fillSector(expected, sector, gen);
+	return memcmp(buf, expected, 512) == 0;
+}
+
+// Fresh disk with generation 0, empty cache and read-ahead buffer
+static void reset(void)
+{
+	for(u32 s = 0; s < DISK_SECTORS; s++) fillSector(&g_sdDisk.data[s * 512], s, 0);
+	disk_ioctl(PDRV, DISK_CACHE_INVALIDATE, NULL);
+	memset(&g_sdDisk.log, 0, sizeof(RamDiskLog));
+	nandProtected = false;
+}
+
+static DiskCacheStats getStats(void)
+{
+	DiskCacheStats stats;
+	disk_ioctl(PDRV, DISK_GET_CACHE_STATS, &stats);
+	return stats;
+}
+
+static bool readOne(u32 sector, u32 gen)
+{
+	u8 buf[512];
+	return disk_read(PDRV, buf, sector, 1) == RES_OK && sectorIs(buf, sector, gen);
+}
+
+static void writeOne(u32 sector, u32 gen)
+{
+	u8 buf[512];
+	fillSector(buf, sector, gen);
+	CHECK_EQ(disk_write(PDRV, buf, sector, 1), RES_OK);
+}
+
+static void test_dirtyWriteBack(void)
+{
+	reset();
+
+	// Small writes stay in the cache until CTRL_SYNC
+	writeOne(10, 1);
+	CHECK_EQ(g_sdDisk.log.writes, 0);
+	CHECK(readOne(10, 1));
+	CHECK(sectorIs(&g_sdDisk.data[10 * 512], 10, 0));
+
+	CHECK_EQ(disk_ioctl(PDRV, CTRL_SYNC, NULL), RES_OK);
+	CHECK_EQ(g_sdDisk.log.writes, 1);
+	CHECK(sectorIs(&g_sdDisk.data[10 * 512], 10, 1));
+
+	// Nothing left to write
+	CHECK_EQ(disk_ioctl(PDRV, CTRL_SYNC, NULL), RES_OK);
+	CHECK_EQ(g_sdDisk.log.writes, 1);
+
+	// Adjacent dirty sectors are written with one command
+	for(u32 s = 23; s >= 20; s--) writeOne(s, 2);
+	writeOne(30, 2);
+	CHECK_EQ(disk_ioctl(PDRV, CTRL_SYNC, NULL), RES_OK);
+	CHECK_EQ(g_sdDisk.log.writes, 3);
+	CHECK_EQ(g_sdDisk.log.writeSectors, 6);
+	for(u32 s = 20; s < 24; s++) CHECK(sectorIs(&g_sdDisk.data[s * 512], s, 2));
+	CHECK(sectorIs(&g_sdDisk.data[30 * 512], 30, 2));
+
+	// A big write bypasses the cache and updates the cached copies
+	u8 big[8 * 512];
+	for(u32 i = 0; i < 8; i++) fillSector(&big[i * 512], 18 + i, 3);
+	CHECK_EQ(disk_write(PDRV, big, 18, 8), RES_OK);
+	CHECK_EQ(g_sdDisk.log.writes, 4);
+	for(u32 s = 18; s < 26; s++) CHECK(readOne(s, 3));
+	CHECK_EQ(disk_ioctl(PDRV, CTRL_SYNC, NULL), RES_OK);
+	CHECK_EQ(g_sdDisk.log.writes, 4);
+}
+
+static void test_lruEviction(void)
+{
+	reset();
+
+	// Fill the cache. Every other sector so the reads are never sequential.
+	for(u32 i = 0; i < SD_CACHE_SECTORS; i++) CHECK(readOne(i * 2, 0));
+	const DiskCacheStats filled = getStats();
+
+	// Sector 0 is the oldest. Using it again makes sector 2 the LRU one.
+	CHECK(readOne(0, 0));
+	CHECK(readOne(1001, 0));
+	DiskCacheStats stats = getStats();
+	CHECK_EQ(stats.hits - filled.hits, 1);
+	CHECK_EQ(stats.misses - filled.misses, 1);
+
+	const u32 reads = g_sdDisk.log.reads;
+	CHECK(readOne(0, 0));
+	CHECK_EQ(g_sdDisk.log.reads, reads);
+	CHECK(readOne(2, 0));
+	CHECK_EQ(g_sdDisk.log.reads, reads + 1);
+
+	// Evicting a dirty sector writes it back first
+	reset();
+	for(u32 i = 0; i < SD_CACHE_SECTORS; i++) writeOne(i * 2, 4);
+	CHECK_EQ(g_sdDisk.log.writes, 0);
+	CHECK(readOne(1001, 0));
+	CHECK_EQ(g_sdDisk.log.writes, 1);
+	CHECK(sectorIs(&g_sdDisk.data[0], 0, 4));
+	CHECK(sectorIs(&g_sdDisk.data[2 * 512], 2, 0));
+
+	// A cached read that misses merges dirty sectors into the result
+	reset();
+	writeOne(41, 5);
+	u8 buf[3 * 512];
+	CHECK_EQ(disk_read(PDRV, buf, 40, 3), RES_OK);
+	CHECK(sectorIs(&buf[0], 40, 0));
+	CHECK(sectorIs(&buf[512], 41, 5));
+	CHECK(sectorIs(&buf[1024], 42, 0));
+}
+
+static void test_prefetch(void)
+{
+	reset();
+
+	// A stream of single sector reads goes through the read-ahead buffer
+	// once it is long enough. The windows grow up to 64 sectors.
+	for(u32 s = 100; s < 400; s++) CHECK(readOne(s, 0));
+	const DiskCacheStats stats = getStats();
+	CHECK(stats.prefetched > 250);
+	CHECK(g_sdDisk.log.reads < 40);
+
+	// Dirty cached sectors are newer than the read-ahead buffer
+	reset();
+	for(u32 s = 200; s < 220; s++) CHECK(readOne(s, 0));
+	writeOne(225, 6);
+	for(u32 s = 220; s < 230; s++) CHECK(readOne(s, (s == 225 ? 6 : 0)));
+
+	// Any device write drops the buffer
+	reset();
+	for(u32 s = 300; s < 320; s++) CHECK(readOne(s, 0));
+	u8 big[8 * 512];
+	for(u32 i = 0; i < 8; i++) fillSector(&big[i * 512], 324 + i, 7);
+	CHECK_EQ(disk_write(PDRV, big, 324, 8), RES_OK);
+	for(u32 s = 320; s < 324; s++) CHECK(readOne(s, 0));
+	for(u32 s = 324; s < 332; s++) CHECK(readOne(s, 7));
+}
+
+static void test_trim(void)
+{
+	reset();
+
+	// Trimmed dirty sectors are dropped, not written back
+	writeOne(50, 8);
+	writeOne(51, 8);
+	writeOne(60, 8);
+	DWORD range[2] = {50, 55};
+	CHECK_EQ(disk_ioctl(PDRV, CTRL_TRIM, range), RES_OK);
+	CHECK_EQ(g_sdDisk.log.trims, 1);
+	CHECK_EQ(g_sdDisk.log.lastTrimStart, 50);
+	CHECK_EQ(g_sdDisk.log.lastTrimCount, 6);
+	CHECK_EQ(disk_ioctl(PDRV, CTRL_SYNC, NULL), RES_OK);
+	CHECK_EQ(g_sdDisk.log.writes, 1);
+	CHECK(sectorIs(&g_sdDisk.data[50 * 512], 50, 0));
+	CHECK(sectorIs(&g_sdDisk.data[60 * 512], 60, 8));
+
+	// Trim drops the read-ahead buffer. The device may return anything after it.
+	reset();
+	for(u32 s = 500; s < 520; s++) CHECK(readOne(s, 0));
+	range[0] = 518;
+	range[1] = 530;
+	CHECK_EQ(disk_ioctl(PDRV, CTRL_TRIM, range), RES_OK);
+	for(u32 s = 520; s < 531; s++) fillSector(&g_sdDisk.data[s * 512], s, 9);
+	const u32 reads = g_sdDisk.log.reads;
+	CHECK(readOne(520, 9));
+	CHECK(g_sdDisk.log.reads > reads);
+
+	// Invalid ranges and protected NAND areas
+	range[0] = 10;
+	range[1] = 9;
+	CHECK_EQ(disk_ioctl(PDRV, CTRL_TRIM, range), RES_PARERR);
+	nandProtected = true;
+	range[1] = 20;
+	CHECK_EQ(disk_ioctl(FATFS_DEV_NUM_CTR_NAND, CTRL_TRIM, range), RES_OK);
+	CHECK_EQ(g_sdDisk.log.trims, 1);
+
+	// Regression: GET_BLOCK_SIZE fell through into CTRL_TRIM
+	DWORD blockSize[2] = {0, 0};
+	CHECK_EQ(disk_ioctl(PDRV, GET_BLOCK_SIZE, blockSize), RES_OK);
+	CHECK_EQ(blockSize[0], 0x100);
+	CHECK_EQ(g_sdDisk.log.trims, 1);
+}
+
+int main(void)
+{
+	if(!ramDiskCreate(&g_sdDisk, DISK_SECTORS) || !ramDiskCreate(&g_nandDisk, DISK_SECTORS))
+		return EXIT_FAILURE;
+
+	RUN_TEST(test_dirtyWriteBack);
+	RUN_TEST(test_lruEviction);
+	RUN_TEST(test_prefetch);
+	RUN_TEST(test_trim);
+
+	ramDiskDestroy(&g_sdDisk);
+	ramDiskDestroy(&g_nandDisk);
+
+	return testFinish("diskio_test");
+}
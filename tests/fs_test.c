@@ -0,0 +1,376 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Host tests of source/arm9/fs.c on FAT32 and exFAT: the NAND backup path,
+// the free cluster count on mount and the reads saved by the FAT cache.
+// The SD images are generated with f_mkfs() from a copy of FatFs built
+// with FF_USE_MKFS 1 (see the Makefile). The backup copies a NAND RAM
+// disk to a file the way menu_func.c does and the SD commands it takes
+// are turned into a modeled throughput.
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "types.h"
+#include "fs.h"
+#include "fatfs/ff.h"
+#include "fatfs/diskio.h"
+#include "job.h"
+#include "arm9/partitions.h"
+#include "ramdisk.h"
+#include "test.h"
+
+
+#define SD_SECTORS        (3u * 1024 * 1024) // 1.5 GiB, allocated on touch
+#define NAND_SECTORS      (64u * 1024 * 2)   // 64 MiB
+#define DEVICE_BUFSIZE    (FS_DEVBUF_SIZE_O3DS) // g_hostSocInfo is Old 3DS
+#define BACKUP_PATH       "sdmc:/nand.bin"
+
+// Rough SD card write costs for the throughput model
+#define SD_CMD_US         (250u) // Per write command (busy wait, CMD25 setup)
+#define SD_SECTOR_US      (25u)  // Per 512 bytes at 20 MB/s
+
+
+typedef struct
+{
+	const char *name;
+	BYTE fmt;
+	DWORD clusterSize;
+} ImageType;
+
+typedef struct
+{
+	u32 writes;
+	u32 writeSectors;
+	u32 modeledKBps;
+	u32 hostMBps;
+} BackupResult;
+
+static const ImageType imageTypes[] =
+{
+	{"FAT32 16 KiB", FM_FAT32 | FM_SFD, 0x4000},
+	{"exFAT 16 KiB", FM_EXFAT | FM_SFD, 0x4000},
+	{"exFAT 128 KiB", FM_EXFAT | FM_SFD, 0x20000}
+};
+
+
+
+bool partitionGetInfo(size_t index, partitionStruct *info)
+{
+	(void)index;
+	(void)info;
+	return false;
+}
+
+void invalidatePrefetchedFirm(void)
+{
+}
+
+static u32 nandWord(u32 i)
+{
+	return i * 0x9E3779B9u ^ (i>>7);
+}
+
+static bool makeImage(const ImageType *const type)
+{
+	static u8 work[0x10000];
+
+	// Unmounted with the previous image
+	memset(g_sdDisk.data, 0, (size_t)512 * 64); // Old boot sectors
+	if(f_mkfs("sdmc:", type->fmt, type->clusterSize, work, sizeof(work)) != FR_OK) return false;
+	disk_ioctl(FATFS_DEV_NUM_SD, DISK_CACHE_INVALIDATE, NULL);
+
+	return fMount(FS_DRIVE_SDMC) == FR_OK;
+}
+
+// Same calls as the NAND backup in menu_func.c. Without preallocate the
+// file grows chunk by chunk like before fExpand() was used.
+static bool backupNand(bool preallocate)
+{
+	const u32 nandSize = NAND_SECTORS * 512;
+	const s32 fHandle = fOpen(BACKUP_PATH, FS_CREATE_ALWAYS | FS_OPEN_WRITE);
+	if(fHandle < 0) return false;
+
+	bool ok = !preallocate || fExpand(fHandle, nandSize) == FR_OK;
+	const s32 devHandle = fPrepareRawAccess(FS_DEVICE_NAND);
+	const s32 dbufHandle = fCreateDeviceBuffer(DEVICE_BUFSIZE);
+	ok = ok && devHandle >= 0 && dbufHandle >= 0;
+
+	for(u32 p = 0; ok && p < nandSize; p += DEVICE_BUFSIZE)
+	{
+		const u32 size = (nandSize - p > DEVICE_BUFSIZE ? DEVICE_BUFSIZE : nandSize - p);
+		ok = fReadToDeviceBuffer(devHandle, p, size, dbufHandle) == FR_OK &&
+		     fsWriteFromDeviceBuffer(fHandle, p, size, dbufHandle) == FR_OK;
+	}
+
+	if(devHandle >= 0 && fFinalizeRawAccess(devHandle) != FR_OK) ok = false;
+	if(dbufHandle >= 0) fFreeDeviceBuffer(dbufHandle);
+	if(fClose(fHandle) != FR_OK) ok = false;
+
+	return ok;
+}
+
+static bool backupMatches(void)
+{
+	const s32 fHandle = fOpen(BACKUP_PATH, FS_OPEN_EXISTING | FS_OPEN_READ);
+	if(fHandle < 0) return false;
+
+	static u32 buf[DEVICE_BUFSIZE / 4];
+	bool ok = fSize(fHandle) == NAND_SECTORS * 512u;
+	for(u32 p = 0; ok && p < NAND_SECTORS * 512u; p += DEVICE_BUFSIZE)
+	{
+		ok = fRead(fHandle, buf, DEVICE_BUFSIZE) == FR_OK &&
+		     memcmp(buf, &g_nandDisk.data[p], DEVICE_BUFSIZE) == 0;
+	}
+	fClose(fHandle);
+
+	return ok;
+}
+
+static BackupResult runBackup(const ImageType *const type, bool preallocate)
+{
+	BackupResult res = {0};
+	CHECK(makeImage(type));
+
+	memset(&g_sdDisk.log, 0, sizeof(RamDiskLog));
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	CHECK(backupNand(preallocate));
+	CHECK_EQ(fUnmount(FS_DRIVE_SDMC), FR_OK); // Includes the final CTRL_SYNC
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	res.writes = g_sdDisk.log.writes;
+	res.writeSectors = g_sdDisk.log.writeSectors;
+	const u64 us = (u64)res.writes * SD_CMD_US + (u64)res.writeSectors * SD_SECTOR_US;
+	res.modeledKBps = (u32)((u64)NAND_SECTORS * 512 * 1000000 / us / 1024);
+	const u64 ns = (u64)(end.tv_sec - start.tv_sec) * 1000000000u + end.tv_nsec - start.tv_nsec;
+	res.hostMBps = (u32)((u64)NAND_SECTORS * 512 * 1000 / ns);
+
+	CHECK_EQ(fMount(FS_DRIVE_SDMC), FR_OK);
+	CHECK(backupMatches());
+	CHECK_EQ(fUnmount(FS_DRIVE_SDMC), FR_OK);
+
+	return res;
+}
+
+static void test_backupFat32VsExfat(void)
+{
+	const u32 numTypes = sizeof(imageTypes) / sizeof(imageTypes[0]);
+	const u32 chunks = NAND_SECTORS * 512 / DEVICE_BUFSIZE;
+	BackupResult prealloc[numTypes], grow[numTypes];
+
+	printf("    %-14s %-9s %9s %9s %12s %10s\n", "image", "fExpand", "SD cmds", "sectors", "model MB/s", "host MB/s");
+	for(u32 i = 0; i < numTypes; i++)
+	{
+		prealloc[i] = runBackup(&imageTypes[i], true);
+		grow[i] = runBackup(&imageTypes[i], false);
+		for(u32 j = 0; j < 2; j++)
+		{
+			const BackupResult *const r = (j ? &grow[i] : &prealloc[i]);
+			printf("    %-14s %-9s %9" PRIu32 " %9" PRIu32 " %8" PRIu32 ".%02" PRIu32 " %10" PRIu32 "\n",
+			       imageTypes[i].name, (j ? "no" : "yes"), r->writes, r->writeSectors,
+			       r->modeledKBps / 1024, r->modeledKBps % 1024 * 100 / 1024, r->hostMBps);
+		}
+
+		// Preallocated backups go through the contiguous path on both filesystems:
+		// one command per device buffer plus a few for the FAT/bitmap and directory.
+		CHECK(prealloc[i].writes >= chunks);
+		CHECK(prealloc[i].writes <= chunks + 16);
+	}
+
+	// Growing files write cluster by cluster. Big exFAT clusters need fewer commands.
+	CHECK(grow[2].writes < grow[0].writes);
+	CHECK(grow[2].modeledKBps > grow[0].modeledKBps);
+	// Preallocation makes the cluster size irrelevant
+	CHECK(prealloc[0].modeledKBps > grow[0].modeledKBps);
+	CHECK(prealloc[1].writes <= prealloc[0].writes);
+}
+
+static bool runJobs(void)
+{
+	bool ran = false;
+	while(JOB_runNext()) ran = true;
+
+	return ran;
+}
+
+static u64 getFree(void)
+{
+	u64 size = 0;
+	CHECK_EQ(fGetFree(FS_DRIVE_SDMC, &size), FR_OK);
+
+	return size;
+}
+
+static void test_freeCountOnMount(void)
+{
+	// f_mkfs() writes a valid FSInfo. Nothing to scan on mount.
+	CHECK(makeImage(&imageTypes[0]));
+	CHECK(!runJobs());
+	u32 reads = g_sdDisk.log.reads;
+	const u64 freeSize = getFree();
+	CHECK_EQ(g_sdDisk.log.reads, reads);
+	CHECK_EQ(fUnmount(FS_DRIVE_SDMC), FR_OK);
+
+	// Without a valid FSInfo the count is made in the background
+	// and written back on unmount
+	g_sdDisk.data[1 * 512] ^= 0xFF; // Lead signature
+	disk_ioctl(FATFS_DEV_NUM_SD, DISK_CACHE_INVALIDATE, NULL);
+	CHECK_EQ(fMount(FS_DRIVE_SDMC), FR_OK);
+	CHECK(runJobs());
+	reads = g_sdDisk.log.reads;
+	CHECK_EQ(getFree(), freeSize);
+	CHECK_EQ(g_sdDisk.log.reads, reads);
+	CHECK_EQ(fUnmount(FS_DRIVE_SDMC), FR_OK);
+	CHECK_EQ(fMount(FS_DRIVE_SDMC), FR_OK);
+	CHECK(!runJobs());
+	CHECK_EQ(getFree(), freeSize);
+	CHECK_EQ(fUnmount(FS_DRIVE_SDMC), FR_OK);
+
+	// exFAT has no FSInfo. The bitmap is counted on the first fGetFree().
+	CHECK(makeImage(&imageTypes[2]));
+	CHECK(!runJobs());
+	reads = g_sdDisk.log.reads;
+	CHECK(getFree() > freeSize);
+	CHECK(g_sdDisk.log.reads > reads);
+	CHECK_EQ(fUnmount(FS_DRIVE_SDMC), FR_OK);
+}
+
+// Fragments NUM files by writing them a cluster at a time in turns.
+// Returns the number of FAT sectors their chains span.
+static u32 writeInterleaved(u32 num, u32 clusters)
+{
+	static u8 cluster[0x1000];
+	s32 handles[4];
+	char path[16];
+	for(u32 i = 0; i < num; i++)
+	{
+		snprintf(path, sizeof(path), "sdmc:/f%" PRIu32, i);
+		handles[i] = fOpen(path, FS_CREATE_ALWAYS | FS_OPEN_WRITE);
+		CHECK(handles[i] >= 0);
+	}
+	for(u32 c = 0; c < clusters; c++)
+	{
+		for(u32 i = 0; i < num; i++) CHECK_EQ(fWrite(handles[i], cluster, sizeof(cluster)), FR_OK);
+	}
+	for(u32 i = 0; i < num; i++) CHECK_EQ(fClose(handles[i]), FR_OK);
+
+	return (num * clusters * 4 + 511) / 512;
+}
+
+static DiskCacheStats getDiskStats(void)
+{
+	DiskCacheStats stats;
+	disk_ioctl(FATFS_DEV_NUM_SD, DISK_GET_CACHE_STATS, &stats);
+
+	return stats;
+}
+
+// Seeks to the end of each file, walking its whole cluster chain.
+// Returns the number of disk_read() calls.
+static u32 walkChains(u32 num)
+{
+	const u32 reads = getDiskStats().readCalls;
+	char path[16];
+	for(u32 i = 0; i < num; i++)
+	{
+		snprintf(path, sizeof(path), "sdmc:/f%" PRIu32, i);
+		const s32 handle = fOpen(path, FS_OPEN_EXISTING | FS_OPEN_READ);
+		CHECK(handle >= 0);
+		CHECK_EQ(fLseek(handle, fSize(handle)), FR_OK);
+		CHECK_EQ(fClose(handle), FR_OK);
+	}
+
+	return getDiskStats().readCalls - reads;
+}
+
+// Counts the free clusters from the FAT or bitmap again.
+// Returns the number of disk_read() calls.
+static u32 recountFree(void)
+{
+	DWORD freeClusters;
+	FATFS *fs;
+	CHECK_EQ(f_getfree("sdmc:", &freeClusters, &fs), FR_OK);
+	fs->free_clst = 0xFFFFFFFF;
+
+	const u32 reads = getDiskStats().readCalls;
+	CHECK(getFree() != 0);
+
+	return getDiskStats().readCalls - reads;
+}
+
+// The FAT cache of fs.c loads 8 FAT or bitmap sectors per disk_read() call.
+// The device commands are mostly merged by the read-ahead in diskio.c
+// either way, so the table shows both.
+static void test_fatCacheReads(void)
+{
+	// 4 KiB clusters so the chains span more FAT sectors than the SD sector cache holds
+	static const ImageType types[] =
+	{
+		{"FAT32 4 KiB", FM_FAT32 | FM_SFD, 0x1000},
+		{"exFAT 4 KiB", FM_EXFAT | FM_SFD, 0x1000}
+	};
+	const u32 files = 4;
+	const u32 lineSectors = 8; // FS_FAT_CACHE_LINE_SECTORS
+
+	printf("    %-12s %11s %11s %10s %11s %11s %10s\n", "image", "FAT sectors", "walk calls",
+	       "walk cmds", "table secs", "count calls", "count cmds");
+	for(u32 i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+	{
+		CHECK(makeImage(&types[i]));
+		const u32 chainSectors = writeInterleaved(files, 4096);
+		CHECK_EQ(fUnmount(FS_DRIVE_SDMC), FR_OK);
+		disk_ioctl(FATFS_DEV_NUM_SD, DISK_CACHE_INVALIDATE, NULL);
+		CHECK_EQ(fMount(FS_DRIVE_SDMC), FR_OK);
+
+		// Without the cache every FAT sector of every chain is a call
+		u32 cmds = g_sdDisk.log.reads;
+		const u32 walkCalls = walkChains(files);
+		const u32 walkCmds = g_sdDisk.log.reads - cmds;
+		CHECK(walkCalls <= files * (chainSectors / lineSectors + 2) + 8);
+
+		// The FAT32 count reads the FAT, the exFAT one the allocation bitmap
+		DWORD freeClusters;
+		FATFS *fs;
+		CHECK_EQ(f_getfree("sdmc:", &freeClusters, &fs), FR_OK);
+		const u32 tableSectors = (fs->fs_type == FS_EXFAT ? (fs->n_fatent - 2 + 4095) / 4096 : fs->fsize);
+		cmds = g_sdDisk.log.reads;
+		const u32 countCalls = recountFree();
+		const u32 countCmds = g_sdDisk.log.reads - cmds;
+		CHECK(countCalls <= tableSectors / lineSectors + 2);
+
+		printf("    %-12s %11" PRIu32 " %11" PRIu32 " %10" PRIu32 " %11" PRIu32 " %11" PRIu32 " %10" PRIu32 "\n",
+		       types[i].name, chainSectors, walkCalls, walkCmds, tableSectors, countCalls, countCmds);
+		CHECK_EQ(fUnmount(FS_DRIVE_SDMC), FR_OK);
+	}
+}
+
+int main(void)
+{
+	if(!ramDiskCreate(&g_sdDisk, SD_SECTORS) || !ramDiskCreate(&g_nandDisk, NAND_SECTORS))
+		return EXIT_FAILURE;
+	for(u32 i = 0; i < NAND_SECTORS * 512 / 4; i++) ((u32*)g_nandDisk.data)[i] = nandWord(i);
+
+	RUN_TEST(test_backupFat32VsExfat);
+	RUN_TEST(test_freeCountOnMount);
+	RUN_TEST(test_fatCacheReads);
+
+	ramDiskDestroy(&g_sdDisk);
+	ramDiskDestroy(&g_nandDisk);
+
+	return testFinish("fs_test");
+}
@@ -0,0 +1,71 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Shared host glue for the tests: the critical section and register
+// stand-ins and the result summary.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "types.h"
+#include "arm.h"
+#include "arm9/hardware/interrupt.h"
+#include "arm9/hardware/cfg9.h"
+#include "test.h"
+
+
+u32 g_testFailures = 0;
+u32 g_hostWfiCount = 0;
+u16 g_hostSocInfo = 0; // Old 3DS
+
+static pthread_mutex_t criticalMutex;
+static pthread_once_t criticalOnce = PTHREAD_ONCE_INIT;
+
+
+
+static void criticalInit(void)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&criticalMutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+void hostCriticalEnter(void)
+{
+	pthread_once(&criticalOnce, criticalInit);
+	pthread_mutex_lock(&criticalMutex);
+}
+
+void hostCriticalLeave(void)
+{
+	pthread_mutex_unlock(&criticalMutex);
+}
+
+int testFinish(const char *name)
+{
+	if(g_testFailures)
+	{
+		printf("%s: %" PRIu32 " check(s) failed\n", name, g_testFailures);
+		return EXIT_FAILURE;
+	}
+
+	printf("%s: OK\n", name);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host stand-in for the ARM9 interrupt header. Critical sections map to
+// one recursive mutex so tests can run the code from several threads
+// like it would run from IRQ and job context on hardware.
+
+#include <pthread.h>
+#include "arm.h"
+#include "types.h"
+
+
+void hostCriticalEnter(void);
+void hostCriticalLeave(void);
+
+
+static inline u32 enterCriticalSection(void)
+{
+	hostCriticalEnter();
+	return 0;
+}
+
+static inline void leaveCriticalSection(u32 oldState)
+{
+	(void)oldState;
+	hostCriticalLeave();
+}
@@ -0,0 +1,244 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host tests for the ARM9 job scheduler (source/arm9/job.c).
+
+#include <string.h>
+#include "types.h"
+#include "arm.h"
+#include "job.h"
+#include "test.h"
+
+
+static char order[64];
+static u32 orderLen;
+
+typedef struct
+{
+	char name;
+	u32 runsLeft; // Returns JOB_AGAIN until this reaches 1
+	s32 result;
+} TestJob;
+
+
+
+static void resetOrder(void)
+{
+	memset(order, 0, sizeof(order));
+	orderLen = 0;
+}
+
+static s32 recordJob(void *arg)
+{
+	TestJob *const tj = (TestJob*)arg;
+	if(orderLen < sizeof(order) - 1) order[orderLen++] = tj->name;
+	JOB_setProgress(orderLen, 100);
+
+	if(tj->runsLeft > 1)
+	{
+		tj->runsLeft--;
+		return JOB_AGAIN;
+	}
+
+	return tj->result;
+}
+
+static void runAll(void)
+{
+	while(JOB_runNext());
+}
+
+static void test_priorityOrder(void)
+{
+	resetOrder();
+	TestJob low = {'l', 1, 0}, norm1 = {'n', 1, 0}, norm2 = {'m', 1, 0}, high = {'h', 1, 0};
+	TestJob pnc = {'p', 1, 0};
+
+	CHECK(JOB_post(JOB_PRIO_LOW, recordJob, &low, true) > 0);
+	CHECK(JOB_post(JOB_PRIO_NORMAL, recordJob, &norm1, true) > 0);
+	CHECK(JOB_post(JOB_PRIO_NORMAL, recordJob, &norm2, true) > 0);
+	CHECK(JOB_post(JOB_PRIO_HIGH, recordJob, &high, true) > 0);
+	CHECK(JOB_post(JOB_PRIO_PANIC, recordJob, &pnc, true) > 0);
+	runAll();
+
+	// Highest priority first, FIFO within a priority.
+	CHECK(strcmp(order, "phnml") == 0);
+}
+
+static void test_againRequeuesAtTail(void)
+{
+	resetOrder();
+	TestJob a = {'a', 3, 7}, b = {'b', 1, 0}, h = {'h', 1, 0};
+
+	const JobHandle ha = JOB_post(JOB_PRIO_NORMAL, recordJob, &a, false);
+	CHECK(JOB_post(JOB_PRIO_NORMAL, recordJob, &b, true) > 0);
+	CHECK(JOB_runNext()); // a -> JOB_AGAIN, goes behind b
+
+	// A high priority job posted while a is chunking runs before its next chunk.
+	CHECK(JOB_post(JOB_PRIO_HIGH, recordJob, &h, true) > 0);
+	runAll();
+	CHECK(strcmp(order, "ahbaa") == 0);
+
+	JobStatus st;
+	CHECK_EQ(JOB_getStatus(ha, &st), 0);
+	CHECK_EQ(st.state, JOB_STATE_DONE);
+	CHECK_EQ(st.result, 7);
+	CHECK_EQ(st.progress, 5);
+	CHECK_EQ(st.total, 100);
+	CHECK_EQ(JOB_release(ha), 7);
+}
+
+static void test_cancel(void)
+{
+	resetOrder();
+	TestJob a = {'a', 1, 0}, b = {'b', 1, 0};
+
+	const JobHandle ha = JOB_post(JOB_PRIO_NORMAL, recordJob, &a, false);
+	const JobHandle hb = JOB_post(JOB_PRIO_NORMAL, recordJob, &b, false);
+	CHECK(JOB_cancel(ha));
+	CHECK(!JOB_cancel(ha)); // Already done
+	runAll();
+	CHECK(strcmp(order, "b") == 0);
+
+	CHECK_EQ(JOB_release(ha), JOB_ERR_CANCELED);
+	CHECK(!JOB_cancel(hb)); // Finished jobs are not touched
+	CHECK_EQ(JOB_release(hb), 0);
+
+	// Canceling the tail must keep the queue intact.
+	resetOrder();
+	const JobHandle hc = JOB_post(JOB_PRIO_LOW, recordJob, &a, true);
+	CHECK(JOB_post(JOB_PRIO_LOW, recordJob, &b, true) > 0);
+	const JobHandle hd = JOB_post(JOB_PRIO_LOW, recordJob, &a, true);
+	CHECK(JOB_cancel(hd));
+	CHECK(JOB_post(JOB_PRIO_LOW, recordJob, &b, true) > 0);
+	CHECK(JOB_cancel(hc));
+	runAll();
+	CHECK(strcmp(order, "bb") == 0);
+}
+
+static void test_staleHandles(void)
+{
+	TestJob a = {'a', 1, 3};
+
+	const JobHandle h = JOB_post(JOB_PRIO_NORMAL, recordJob, &a, false);
+	runAll();
+	CHECK_EQ(JOB_release(h), 3);
+	CHECK_EQ(JOB_release(h), JOB_ERR_INVALID);
+
+	JobStatus st;
+	CHECK_EQ(JOB_getStatus(h, &st), JOB_ERR_INVALID);
+
+	// The slot gets reused with a new generation. The old handle stays dead.
+	const JobHandle h2 = JOB_post(JOB_PRIO_NORMAL, recordJob, &a, false);
+	CHECK(h2 > 0 && h2 != h);
+	CHECK(!JOB_cancel(h));
+	CHECK(JOB_cancel(h2));
+	CHECK_EQ(JOB_release(h2), JOB_ERR_CANCELED);
+
+	CHECK_EQ(JOB_release(-5), JOB_ERR_INVALID);
+	CHECK_EQ(JOB_post(JOB_PRIO_NUM, recordJob, &a, true), JOB_ERR_INVALID);
+	CHECK_EQ(JOB_post(JOB_PRIO_LOW, NULL, &a, true), JOB_ERR_INVALID);
+}
+
+static void test_wait(void)
+{
+	resetOrder();
+	TestJob a = {'a', 4, 11}, b = {'b', 1, 0};
+
+	CHECK(JOB_post(JOB_PRIO_HIGH, recordJob, &b, true) > 0);
+	const JobHandle ha = JOB_post(JOB_PRIO_LOW, recordJob, &a, false);
+
+	// Runs a in place until done, skipping the queue.
+	CHECK_EQ(JOB_wait(ha), 11);
+	CHECK(strcmp(order, "aaaa") == 0);
+	CHECK_EQ(JOB_wait(ha), 11); // Already done
+	CHECK_EQ(JOB_release(ha), 11);
+	runAll();
+	CHECK(strcmp(order, "aaaab") == 0);
+
+	const JobHandle hf = JOB_post(JOB_PRIO_LOW, recordJob, &b, true);
+	CHECK_EQ(JOB_wait(hf), JOB_ERR_INVALID); // Auto freed jobs can't be waited on
+	runAll();
+}
+
+static JobHandle parentHandle;
+static s32 waitOnParent(void *arg)
+{
+	(void)arg;
+	return JOB_wait(parentHandle);
+}
+
+static s32 parentJob(void *arg)
+{
+	JobHandle *const child = (JobHandle*)arg;
+	*child = JOB_post(JOB_PRIO_HIGH, waitOnParent, NULL, false);
+	return JOB_wait(*child); // The child must fail instead of deadlocking
+}
+
+static void test_waitOnParent(void)
+{
+	JobHandle child = 0;
+	parentHandle = JOB_post(JOB_PRIO_NORMAL, parentJob, &child, false);
+	runAll();
+	CHECK_EQ(JOB_release(child), JOB_ERR_INVALID);
+	CHECK_EQ(JOB_release(parentHandle), JOB_ERR_INVALID);
+}
+
+static void test_noSlot(void)
+{
+	TestJob a = {'a', 1, 0};
+	JobHandle handles[JOB_MAX_JOBS];
+
+	for(u32 i = 0; i < JOB_MAX_JOBS; i++)
+	{
+		handles[i] = JOB_post(JOB_PRIO_LOW, recordJob, &a, false);
+		CHECK(handles[i] > 0);
+	}
+	CHECK_EQ(JOB_post(JOB_PRIO_HIGH, recordJob, &a, false), JOB_ERR_NO_SLOT);
+
+	for(u32 i = 0; i < JOB_MAX_JOBS; i++) CHECK(JOB_cancel(handles[i]));
+	for(u32 i = 0; i < JOB_MAX_JOBS; i++) CHECK_EQ(JOB_release(handles[i]), JOB_ERR_CANCELED);
+	CHECK(!JOB_runNext());
+}
+
+static void test_idle(void)
+{
+	TestJob a = {'a', 1, 0};
+
+	const u32 before = g_hostWfiCount;
+	CHECK(JOB_post(JOB_PRIO_LOW, recordJob, &a, true) > 0);
+	JOB_idle(); // Work is queued. Must not sleep.
+	CHECK_EQ(g_hostWfiCount, before);
+	runAll();
+	JOB_idle();
+	CHECK_EQ(g_hostWfiCount, before + 1);
+}
+
+int main(void)
+{
+	RUN_TEST(test_priorityOrder);
+	RUN_TEST(test_againRequeuesAtTail);
+	RUN_TEST(test_cancel);
+	RUN_TEST(test_staleHandles);
+	RUN_TEST(test_wait);
+	RUN_TEST(test_waitOnParent);
+	RUN_TEST(test_noSlot);
+	RUN_TEST(test_idle);
+
+	return testFinish("job_test");
+}
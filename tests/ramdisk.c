@@ -0,0 +1,93 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "arm9/dev.h"
+#include "ramdisk.h"
+
+
+RamDisk g_sdDisk = {0};
+RamDisk g_nandDisk = {0};
+
+
+
+static bool diskRead(RamDisk *const disk, u32 sector, u32 count, void *buf)
+{
+	if(sector > disk->sectors || count > disk->sectors - sector) return false;
+	memcpy(buf, &disk->data[(size_t)sector * 512], (size_t)count * 512);
+	disk->log.reads++;
+	disk->log.readSectors += count;
+	return true;
+}
+
+static bool diskWrite(RamDisk *const disk, u32 sector, u32 count, const void *buf)
+{
+	if(sector > disk->sectors || count > disk->sectors - sector) return false;
+	memcpy(&disk->data[(size_t)sector * 512], buf, (size_t)count * 512);
+	disk->log.writes++;
+	disk->log.writeSectors += count;
+	return true;
+}
+
+static bool diskTrim(RamDisk *const disk, u32 sector, u32 count)
+{
+	if(sector > disk->sectors || count > disk->sectors - sector) return false;
+	disk->log.trims++;
+	disk->log.lastTrimStart = sector;
+	disk->log.lastTrimCount = count;
+	return true;
+}
+
+static bool sdInit(void)                                      {return g_sdDisk.data != NULL;}
+static bool sdRead(u32 sector, u32 count, void *buf)          {return diskRead(&g_sdDisk, sector, count, buf);}
+static bool sdWrite(u32 sector, u32 count, const void *buf)   {return diskWrite(&g_sdDisk, sector, count, buf);}
+static u32  sdSectorCount(void)                               {return g_sdDisk.sectors;}
+static bool sdTrim(u32 sector, u32 count)                     {return diskTrim(&g_sdDisk, sector, count);}
+
+static bool nandInit(void)                                    {return g_nandDisk.data != NULL;}
+static bool nandRead(u32 sector, u32 count, void *buf)        {return diskRead(&g_nandDisk, sector, count, buf);}
+static bool nandWrite(u32 sector, u32 count, const void *buf) {return diskWrite(&g_nandDisk, sector, count, buf);}
+static u32  nandSectorCount(void)                             {return g_nandDisk.sectors;}
+static bool nandTrim(u32 sector, u32 count)                   {return diskTrim(&g_nandDisk, sector, count);}
+
+static const dev_struct sdDev = {"sd", true, sdInit, sdRead, sdWrite, sdInit,
+                                 sdInit, sdSectorCount, sdTrim};
+static const dev_struct nandDev = {"nand", true, nandInit, nandRead, nandWrite, nandInit,
+                                   nandInit, nandSectorCount, nandTrim};
+
+const dev_struct *dev_sdcard = &sdDev;
+const dev_struct *dev_rawnand = &nandDev;
+const dev_struct *dev_decnand = &nandDev;
+
+bool ramDiskCreate(RamDisk *const disk, u32 sectors)
+{
+	disk->data = (u8*)calloc(sectors, 512);
+	disk->sectors = (disk->data ? sectors : 0);
+	memset(&disk->log, 0, sizeof(RamDiskLog));
+
+	return disk->data != NULL;
+}
+
+void ramDiskDestroy(RamDisk *const disk)
+{
+	free(disk->data);
+	disk->data = NULL;
+	disk->sectors = 0;
+}
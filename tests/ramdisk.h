@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// RAM disks standing in for the SD card and NAND devices of arm9/dev.h.
+// Every device command is counted.
+
+#include "types.h"
+
+
+typedef struct
+{
+	u32 reads;
+	u32 readSectors;
+	u32 writes;
+	u32 writeSectors;
+	u32 trims;
+	u32 lastTrimStart;
+	u32 lastTrimCount;
+} RamDiskLog;
+
+typedef struct
+{
+	u8 *data;
+	u32 sectors;
+	RamDiskLog log;
+} RamDisk;
+
+// Backing dev_sdcard and dev_rawnand/dev_decnand
+extern RamDisk g_sdDisk;
+extern RamDisk g_nandDisk;
+
+
+
+bool ramDiskCreate(RamDisk *const disk, u32 sectors);
+void ramDiskDestroy(RamDisk *const disk);
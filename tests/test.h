@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include "types.h"
+
+
+extern u32 g_testFailures;
+
+// Non-fatal check. The test binary exits with failure if any check failed.
+#define CHECK(cond)                                                   \
+	do                                                                \
+	{                                                                 \
+		if(!(cond))                                                   \
+		{                                                             \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			g_testFailures++;                                         \
+		}                                                             \
+	} while(0)
+
+#define CHECK_EQ(a, b)                                                \
+	do                                                                \
+	{                                                                 \
+		const long long _a = (long long)(a), _b = (long long)(b);     \
+		if(_a != _b)                                                  \
+		{                                                             \
+			fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+			        __FILE__, __LINE__, #a, #b, _a, _b);              \
+			g_testFailures++;                                         \
+		}                                                             \
+	} while(0)
+
+// Runs a test function and prints its name.
+#define RUN_TEST(func) \
+	do                 \
+	{                  \
+		printf("  %s\n", #func); \
+		func();        \
+	} while(0)
+
+// Prints the summary. Returns the exit code for main().
+int testFinish(const char *name);
@@ -7,11 +7,65 @@
 /* storage control modules to the FatFs module with a defined API.       */
 /*-----------------------------------------------------------------------*/
 
+#include <stdlib.h>
+#include <string.h>
 #include "ff.h"			/* Obtains integer types */
 #include "diskio.h"		/* Declarations of disk functions */
 #include "types.h"
+#include "fs.h"
 #include "arm9/dev.h"
 
+
+// Sector cache size per physical drive. The same on New 3DS, its extra
+// ARM9 RAM is taken by the bigger device buffer (see fs.c).
+#define CACHE_SECTORS_SD        (64)
+#define CACHE_SECTORS_TWL_NAND  (32)
+#define CACHE_SECTORS_CTR_NAND  (128)
+
+// Requests with at least this many sectors bypass the cache.
+#define CACHE_BYPASS_SECTORS    (8)
+// Reads continuing a sequential run of at least this many sectors bypass it too.
+#define CACHE_SEQ_RUN_SECTORS   (16)
+
+#define CACHE_NO_SECTOR         (0xFFFFFFFFu)
+
+// Read-ahead window in sectors. Doubles while a stream keeps running past it.
+#define PREFETCH_MIN_SECTORS    (16)
+#define PREFETCH_MAX_SECTORS    (64)
+
+// Maximum number of adjacent dirty sectors written back with one command
+#define COMBINE_MAX_SECTORS     (32)
+
+
+typedef struct
+{
+	u32 sector;     // CACHE_NO_SECTOR = unused
+	u32 lastUse;
+	bool dirty;
+} CacheSlot;
+
+typedef struct
+{
+	u8 *data;
+	CacheSlot *slots;
+	u32 num;        // 0 = uncached
+	bool allocated; // Allocation attempted
+	u32 clock;
+	u32 seqNext;    // Sector following the last read
+	u32 seqRun;     // Sectors read sequentially up to seqNext
+	DiskCacheStats stats;
+} SectorCache;
+
+typedef struct
+{
+	u8 *data;
+	bool allocated; // Allocation attempted
+	BYTE pdrv;
+	u32 start;
+	u32 count;      // 0 = empty
+	u32 window;
+} Prefetch;
+
 // Get's set externally in dev.c
 u32 ctr_nand_sector;
 
@@ -22,6 +76,267 @@ PARTITION VolToPart[] = {
     {2, 1}      /* Logical drive 3 ==> Physical drive 2, 1st partition */
 };
 
+static const u16 cacheSectors[FATFS_NUM_DEVS] =
+{
+	CACHE_SECTORS_SD,
+	CACHE_SECTORS_TWL_NAND,
+	CACHE_SECTORS_CTR_NAND
+};
+
+_Static_assert((CACHE_SECTORS_SD + CACHE_SECTORS_TWL_NAND + CACHE_SECTORS_CTR_NAND) * (512 + sizeof(CacheSlot)) +
+               (PREFETCH_MAX_SECTORS + COMBINE_MAX_SECTORS) * 512 <= DISK_HEAP_SIZE,
+               "DISK_HEAP_SIZE is too small");
+
+static SectorCache sectorCaches[FATFS_NUM_DEVS] = {0};
+static Prefetch prefetch = {.window = PREFETCH_MIN_SECTORS};
+static u8 *combineBuf = NULL;
+static bool combineBufAllocated = false;
+
+
+
+static bool devRead(BYTE pdrv, BYTE *buff, u32 sector, u32 count)
+{
+	switch(pdrv)
+	{
+		case FATFS_DEV_NUM_SD:
+			return dev_sdcard->read_sector(sector, count, buff);
+		case FATFS_DEV_NUM_TWL_NAND:
+			return dev_decnand->read_sector(sector, count, buff);
+		case FATFS_DEV_NUM_CTR_NAND:
+			return dev_decnand->read_sector(ctr_nand_sector + sector, count, buff);
+		default:
+			return false;
+	}
+}
+
+static void prefetchCancel(void)
+{
+	prefetch.count = 0;
+	prefetch.window = PREFETCH_MIN_SECTORS;
+}
+
+static bool devWrite(BYTE pdrv, const BYTE *buff, u32 sector, u32 count)
+{
+	// Any write may change what is in the read-ahead buffer
+	prefetchCancel();
+	if(pdrv < FATFS_NUM_DEVS) sectorCaches[pdrv].stats.writeCmds++;
+
+	switch(pdrv)
+	{
+		case FATFS_DEV_NUM_SD:
+			return dev_sdcard->write_sector(sector, count, buff);
+		case FATFS_DEV_NUM_TWL_NAND:
+			return dev_decnand->write_sector(sector, count, buff);
+		case FATFS_DEV_NUM_CTR_NAND:
+			return dev_decnand->write_sector(ctr_nand_sector + sector, count, buff);
+		default:
+			return false;
+	}
+}
+
+static u32 devSectorCount(BYTE pdrv)
+{
+	switch(pdrv)
+	{
+		case FATFS_DEV_NUM_SD:
+			return dev_sdcard->get_sector_count();
+		// dev_decnand has no get_sector_count(). It spans the whole NAND.
+		case FATFS_DEV_NUM_TWL_NAND:
+			return dev_rawnand->get_sector_count();
+		case FATFS_DEV_NUM_CTR_NAND:
+			return dev_rawnand->get_sector_count() - ctr_nand_sector;
+		default:
+			return 0;
+	}
+}
+
+// Serves reads from the read-ahead buffer. Sequential reads smaller than
+// the window refill it with one multi-block read starting at the request.
+// Returns false if the caller has to read from the device.
+static bool prefetchRead(BYTE pdrv, BYTE *buff, u32 start, u32 count, bool sequential)
+{
+	Prefetch *const pf = &prefetch;
+	const bool ours = (pf->count != 0 && pf->pdrv == pdrv);
+
+	if(ours && start - pf->start < pf->count && count <= pf->count - (start - pf->start))
+	{
+		memcpy(buff, &pf->data[(start - pf->start)<<9], count<<9);
+		return true;
+	}
+
+	if(!sequential) pf->window = PREFETCH_MIN_SECTORS;
+	else if(ours && start - pf->start <= pf->count && pf->window < PREFETCH_MAX_SECTORS)
+		pf->window <<= 1; // The stream used up the last window
+
+	if(!sequential || count >= pf->window) return false;
+
+	if(!pf->allocated)
+	{
+		pf->allocated = true;
+		pf->data = (u8*)malloc(PREFETCH_MAX_SECTORS<<9);
+	}
+	if(!pf->data) return false;
+
+	const u32 left = devSectorCount(pdrv) - start;
+	const u32 num = (pf->window < left ? pf->window : left);
+	pf->count = 0;
+	if(num <= count || !devRead(pdrv, pf->data, start, num)) return false;
+
+	pf->pdrv = pdrv;
+	pf->start = start;
+	pf->count = num;
+	memcpy(buff, pf->data, count<<9);
+
+	return true;
+}
+
+static void cacheInvalidate(SectorCache *cache)
+{
+	for(u32 i = 0; i < cache->num; i++)
+	{
+		cache->slots[i].sector = CACHE_NO_SECTOR;
+		cache->slots[i].dirty = false;
+	}
+	cache->seqNext = CACHE_NO_SECTOR;
+	cache->seqRun = 0;
+}
+
+// Allocates the cache on first use. Runs uncached if there is not enough memory.
+static SectorCache* cacheGet(BYTE pdrv)
+{
+	SectorCache *const cache = &sectorCaches[pdrv];
+	if(cache->allocated) return cache;
+	cache->allocated = true;
+
+	const u32 num = cacheSectors[pdrv];
+	cache->data = (u8*)malloc(num<<9);
+	cache->slots = (CacheSlot*)malloc(num * sizeof(CacheSlot));
+	if(!cache->data || !cache->slots)
+	{
+		free(cache->data);
+		free(cache->slots);
+		cache->data = NULL;
+		cache->slots = NULL;
+		return cache;
+	}
+
+	cache->num = num;
+	cacheInvalidate(cache);
+
+	return cache;
+}
+
+static CacheSlot* cacheLookup(SectorCache *cache, u32 sector)
+{
+	for(u32 i = 0; i < cache->num; i++)
+	{
+		if(cache->slots[i].sector == sector) return &cache->slots[i];
+	}
+
+	return NULL;
+}
+
+static inline u8* cacheSlotData(const SectorCache *cache, const CacheSlot *slot)
+{
+	return &cache->data[(u32)(slot - cache->slots)<<9];
+}
+
+static inline bool cacheIsDirty(SectorCache *cache, u32 sector)
+{
+	const CacheSlot *const slot = cacheLookup(cache, sector);
+
+	return slot && slot->dirty;
+}
+
+// Writes back the run of adjacent dirty sectors around slot with one command.
+// FatFs only relies on write order at CTRL_SYNC so merging is safe.
+static bool cacheWriteBack(BYTE pdrv, SectorCache *cache, CacheSlot *slot)
+{
+	if(!combineBufAllocated)
+	{
+		combineBufAllocated = true;
+		combineBuf = (u8*)malloc(COMBINE_MAX_SECTORS<<9);
+	}
+
+	u32 first = slot->sector;
+	u32 num = 1;
+	if(combineBuf)
+	{
+		while(num < COMBINE_MAX_SECTORS && first > 0 && cacheIsDirty(cache, first - 1))
+		{
+			first--;
+			num++;
+		}
+		while(num < COMBINE_MAX_SECTORS && cacheIsDirty(cache, first + num)) num++;
+	}
+
+	if(num == 1)
+	{
+		if(!devWrite(pdrv, cacheSlotData(cache, slot), slot->sector, 1)) return false;
+		slot->dirty = false;
+		cache->stats.writeBacks++;
+
+		return true;
+	}
+
+	for(u32 i = 0; i < num; i++)
+		memcpy(&combineBuf[i<<9], cacheSlotData(cache, cacheLookup(cache, first + i)), 512);
+
+	if(!devWrite(pdrv, combineBuf, first, num)) return false;
+
+	for(u32 i = 0; i < num; i++) cacheLookup(cache, first + i)->dirty = false;
+	cache->stats.writeBacks += num;
+
+	return true;
+}
+
+// Returns the least recently used slot. Dirty slots are written back first.
+static CacheSlot* cacheEvict(BYTE pdrv, SectorCache *cache)
+{
+	CacheSlot *victim = &cache->slots[0];
+	for(u32 i = 0; i < cache->num; i++)
+	{
+		CacheSlot *const slot = &cache->slots[i];
+		if(slot->sector == CACHE_NO_SECTOR)
+		{
+			victim = slot;
+			break;
+		}
+		if(slot->lastUse < victim->lastUse) victim = slot;
+	}
+
+	if(victim->dirty && !cacheWriteBack(pdrv, cache, victim)) return NULL;
+	victim->sector = CACHE_NO_SECTOR;
+
+	return victim;
+}
+
+// Drops cached sectors in the range. Dirty ones are discarded too.
+static void cacheDiscard(SectorCache *cache, u32 start, u32 count)
+{
+	for(u32 i = 0; i < cache->num; i++)
+	{
+		CacheSlot *const slot = &cache->slots[i];
+		if(slot->sector - start < count)
+		{
+			slot->sector = CACHE_NO_SECTOR;
+			slot->dirty = false;
+		}
+	}
+}
+
+static bool cacheFlush(BYTE pdrv, SectorCache *cache)
+{
+	bool res = true;
+	for(u32 i = 0; i < cache->num; i++)
+	{
+		CacheSlot *const slot = &cache->slots[i];
+		if(slot->dirty && !cacheWriteBack(pdrv, cache, slot)) res = false;
+	}
+
+	return res;
+}
+
 
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
@@ -61,6 +376,10 @@ DSTATUS disk_initialize (
 {
 	DSTATUS stat = 0;
 
+	// Cached sectors of a device that went away are stale
+	if(pdrv < FATFS_NUM_DEVS && (disk_status(pdrv) & STA_NOINIT))
+		cacheInvalidate(&sectorCaches[pdrv]);
+
 	switch(pdrv)
 	{
 		case FATFS_DEV_NUM_SD:
@@ -90,24 +409,79 @@ DRESULT disk_read (
 	UINT count		/* Number of sectors to read */
 )
 {
-	DRESULT res = RES_OK;
+	if(pdrv >= FATFS_NUM_DEVS) return RES_PARERR;
 
-	switch(pdrv)
+	SectorCache *const cache = cacheGet(pdrv);
+	const u32 start = (u32)sector;
+	cache->stats.readCalls++;
+
+	const bool sequential = (start == cache->seqNext);
+	if(sequential) cache->seqRun += count;
+	else cache->seqRun = count;
+	cache->seqNext = start + count;
+
+	if(cache->num == 0 || count >= CACHE_BYPASS_SECTORS || cache->seqRun >= CACHE_SEQ_RUN_SECTORS)
 	{
-		case FATFS_DEV_NUM_SD:
-			if(!dev_sdcard->read_sector((u32)sector, (u32)count, buff)) res = RES_ERROR;
-			break;
-		case FATFS_DEV_NUM_TWL_NAND:
-			if(!dev_decnand->read_sector((u32)sector, (u32)count, buff)) res = RES_ERROR;
-			break;
-		case FATFS_DEV_NUM_CTR_NAND:
-			if(!dev_decnand->read_sector(ctr_nand_sector + (u32)sector, (u32)count, buff)) res = RES_ERROR;
-			break;
-		default:
-			res = RES_PARERR;
+		if(prefetchRead(pdrv, buff, start, count, sequential))
+			cache->stats.prefetched += count;
+		else
+		{
+			if(!devRead(pdrv, buff, start, count)) return RES_ERROR;
+			cache->stats.bypassed += count;
+		}
+
+		// Dirty sectors are newer than what is on the device
+		for(u32 i = 0; i < cache->num; i++)
+		{
+			const CacheSlot *const slot = &cache->slots[i];
+			if(slot->dirty && slot->sector - start < count)
+				memcpy(&buff[(slot->sector - start)<<9], cacheSlotData(cache, slot), 512);
+		}
+
+		return RES_OK;
 	}
 
-	return res;
+	u32 i;
+	for(i = 0; i < count; i++)
+	{
+		if(!cacheLookup(cache, start + i)) break;
+	}
+
+	// Read the whole request in one go if anything is missing
+	const bool allHit = (i == count);
+	if(!allHit)
+	{
+		if(!devRead(pdrv, buff, start, count)) return RES_ERROR;
+
+		// Merge dirty sectors before evicting anything. Evictions below
+		// may write back sectors of this request.
+		for(i = 0; i < count; i++)
+		{
+			const CacheSlot *const slot = cacheLookup(cache, start + i);
+			if(slot && slot->dirty) memcpy(&buff[i<<9], cacheSlotData(cache, slot), 512);
+		}
+	}
+
+	for(i = 0; i < count; i++)
+	{
+		CacheSlot *slot = cacheLookup(cache, start + i);
+		if(slot)
+		{
+			if(allHit) memcpy(&buff[i<<9], cacheSlotData(cache, slot), 512);
+			cache->stats.hits++;
+		}
+		else
+		{
+			slot = cacheEvict(pdrv, cache);
+			if(!slot) return RES_ERROR;
+			memcpy(cacheSlotData(cache, slot), &buff[i<<9], 512);
+			slot->sector = start + i;
+			cache->stats.misses++;
+		}
+		slot->lastUse = ++cache->clock;
+	}
+
+	return RES_OK;
 }
 
 
@@ -125,24 +499,45 @@ DRESULT disk_write (
 	UINT count			/* Number of sectors to write */
 )
 {
-	DRESULT res = RES_OK;
+	if(pdrv >= FATFS_NUM_DEVS) return RES_PARERR;
 
-	switch(pdrv)
+	SectorCache *const cache = cacheGet(pdrv);
+	const u32 start = (u32)sector;
+
+	if(cache->num == 0 || count >= CACHE_BYPASS_SECTORS)
 	{
-		case FATFS_DEV_NUM_SD:
-			if(!dev_sdcard->write_sector((u32)sector, (u32)count, buff)) res = RES_ERROR;
-			break;
-		case FATFS_DEV_NUM_TWL_NAND:
-			if(!dev_decnand->write_sector((u32)sector, (u32)count, buff)) res = RES_ERROR;
-			break;
-		case FATFS_DEV_NUM_CTR_NAND:
-			if(!dev_decnand->write_sector(ctr_nand_sector + (u32)sector, (u32)count, buff)) res = RES_ERROR;
-			break;
-		default:
-			res = RES_PARERR;
+		if(!devWrite(pdrv, buff, start, count)) return RES_ERROR;
+		cache->stats.bypassed += count;
+
+		// Keep cached copies in sync. They are clean now.
+		for(u32 i = 0; i < cache->num; i++)
+		{
+			CacheSlot *const slot = &cache->slots[i];
+			if(slot->sector - start < count)
+			{
+				memcpy(cacheSlotData(cache, slot), &buff[(slot->sector - start)<<9], 512);
+				slot->dirty = false;
+			}
+		}
+
+		return RES_OK;
 	}
 
-	return res;
+	for(u32 i = 0; i < count; i++)
+	{
+		CacheSlot *slot = cacheLookup(cache, start + i);
+		if(!slot)
+		{
+			slot = cacheEvict(pdrv, cache);
+			if(!slot) return RES_ERROR;
+			slot->sector = start + i;
+		}
+		memcpy(cacheSlotData(cache, slot), &buff[i<<9], 512);
+		slot->dirty = true;
+		slot->lastUse = ++cache->clock;
+	}
+
+	return RES_OK;
 }
 
 #endif
@@ -189,8 +584,36 @@ DRESULT disk_ioctl (
 			break;
 		case GET_BLOCK_SIZE:
 			*(DWORD*)buff = 0x100; // Default to 128 KB
+			break;
 		case CTRL_TRIM:
+			{
+				const DWORD *const range = (const DWORD*)buff;
+				if(range[1] < range[0])
+				{
+					res = RES_PARERR;
+					break;
+				}
+
+				const u32 count = range[1] - range[0] + 1;
+				cacheDiscard(&sectorCaches[pdrv], range[0], count);
+				prefetchCancel();
+
+				u32 start = range[0];
+				if(pdrv == FATFS_DEV_NUM_CTR_NAND) start += ctr_nand_sector;
+				// TRIM is only a hint so skipping protected areas is fine
+				if(pdrv != FATFS_DEV_NUM_SD && fIsNandRangeProtected(start, count)) break;
+				if(dev->trim_sector && !dev->trim_sector(start, count)) res = RES_ERROR;
+			}
+			break;
 		case CTRL_SYNC:
+			if(!cacheFlush(pdrv, &sectorCaches[pdrv])) res = RES_ERROR;
+			break;
+		case DISK_CACHE_INVALIDATE:
+			cacheInvalidate(&sectorCaches[pdrv]);
+			prefetchCancel();
+			break;
+		case DISK_GET_CACHE_STATS:
+			memcpy(buff, &sectorCaches[pdrv].stats, sizeof(DiskCacheStats));
 			break;
 		default:
 			res = RES_PARERR;
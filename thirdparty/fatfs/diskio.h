@@ -12,6 +12,10 @@ extern "C" {
 #define FATFS_DEV_NUM_SD        0
 #define FATFS_DEV_NUM_TWL_NAND  1
 #define FATFS_DEV_NUM_CTR_NAND  2
+#define FATFS_NUM_DEVS          3
+
+/* Heap used by the sector caches, read-ahead and write combine buffers at most */
+#define DISK_HEAP_SIZE          (164 * 1024)
 
 /* Status of Disk Functions */
 typedef BYTE	DSTATUS;
@@ -26,6 +30,18 @@ typedef enum {
 } DRESULT;
 
 
+/* Sector cache counters */
+typedef struct {
+	DWORD hits;			/* Sectors served from the cache */
+	DWORD misses;		/* Sectors read from the device and cached */
+	DWORD bypassed;		/* Sectors transferred without the cache */
+	DWORD prefetched;	/* Sectors served from the read-ahead buffer */
+	DWORD writeBacks;	/* Dirty sectors written to the device */
+	DWORD writeCmds;	/* Write commands issued to the device */
+	DWORD readCalls;	/* disk_read() calls */
+} DiskCacheStats;
+
+
 /*---------------------------------------*/
 /* Prototypes for disk control functions */
 
@@ -69,6 +85,10 @@ DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 #define ISDIO_WRITE			56	/* Write data to SD iSDIO register */
 #define ISDIO_MRITE			57	/* Masked write data to SD iSDIO register */
 
+/* fastboot3DS specific ioctl command */
+#define DISK_CACHE_INVALIDATE	60	/* Drop all cached sectors without writing them back */
+#define DISK_GET_CACHE_STATS	61	/* Get sector cache counters (DiskCacheStats) */
+
 /* ATA/CF specific ioctl command */
 #define ATA_GET_REV			20	/* Get F/W revision */
 #define ATA_GET_MODEL		21	/* Get model name */
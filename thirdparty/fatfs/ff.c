@@ -1049,6 +1049,9 @@ static FRESULT sync_window (	/* Returns FR_OK or FR_DISK_ERR */
 	if (fs->wflag) {	/* Is the disk access window dirty */
 		if (disk_write(fs->pdrv, fs->win, fs->winsect, 1) == RES_OK) {	/* Write back the window */
 			fs->wflag = 0;	/* Clear window dirty flag */
+#if FF_USE_FAT_CACHE
+			ff_fatcache_write(fs, fs->win, fs->winsect);	/* Keep the cached copy current */
+#endif
 			if (fs->winsect - fs->fatbase < fs->fsize) {	/* Is it in the 1st FAT? */
 				if (fs->n_fats == 2) disk_write(fs->pdrv, fs->win, fs->winsect + fs->fsize, 1);	/* Reflect it to 2nd FAT if needed */
 			}
@@ -1074,10 +1077,21 @@ static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
 		res = sync_window(fs);		/* Write-back changes */
 #endif
 		if (res == FR_OK) {			/* Fill sector window with new data */
+#if FF_USE_FAT_CACHE
+			if (ff_fatcache_read(fs, fs->win, sector)) {
+				fs->winsect = sector;
+				return FR_OK;
+			}
+#endif
 			if (disk_read(fs->pdrv, fs->win, sector, 1) != RES_OK) {
 				sector = 0xFFFFFFFF;	/* Invalidate window if read data is not valid */
 				res = FR_DISK_ERR;
 			}
+#if FF_USE_FAT_CACHE
+			else {
+				ff_fatcache_write(fs, fs->win, sector);
+			}
+#endif
 			fs->winsect = sector;
 		}
 	}
@@ -350,6 +350,12 @@ void* ff_memalloc (UINT msize);			/* Allocate memory block */
 void ff_memfree (void* mblock);			/* Free memory block */
 #endif
 
+/* FAT window cache functions */
+#if FF_USE_FAT_CACHE
+int ff_fatcache_read (FATFS* fs, BYTE* buff, DWORD sector);			/* 1: Hit, buff has been filled */
+void ff_fatcache_write (FATFS* fs, const BYTE* buff, DWORD sector);	/* Store a sector read from or written to the disk */
+#endif
+
 /* Sync functions */
 #if FF_FS_REENTRANT
 int ff_cre_syncobj (BYTE vol, FF_SYNC_t* sobj);	/* Create a sync object */
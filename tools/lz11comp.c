@@ -0,0 +1,201 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host tool. Compresses a file to the LZ11 format understood by lz11Decompress().
+// Usage: lz11comp <in> <out>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+
+#define WINDOW_SIZE  (0x1000)
+#define MIN_MATCH    (3)
+#define MAX_MATCH    (0x10110)
+#define HASH_BITS    (14)
+#define HASH_SIZE    (1u<<HASH_BITS)
+#define MAX_CHAIN    (256)
+
+
+
+static uint32_t hash3(const uint8_t *p)
+{
+	return ((p[0]<<16 | p[1]<<8 | p[2]) * 2654435761u)>>(32 - HASH_BITS);
+}
+
+static uint8_t* readFile(const char *path, uint32_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	if(!f) return NULL;
+
+	fseek(f, 0, SEEK_END);
+	const long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if(len <= 0 || len > 0xFFFFFF)
+	{
+		fclose(f);
+		return NULL;
+	}
+
+	uint8_t *buf = malloc(len);
+	if(!buf || fread(buf, 1, len, f) != (size_t)len)
+	{
+		free(buf);
+		fclose(f);
+		return NULL;
+	}
+	fclose(f);
+
+	*size = len;
+	return buf;
+}
+
+// Greedy compression with hash chains. Returns the compressed size.
+static uint32_t compress(const uint8_t *in, uint32_t size, uint8_t *out)
+{
+	int32_t *head = malloc(HASH_SIZE * sizeof(int32_t));
+	int32_t *prev = malloc(size * sizeof(int32_t));
+	if(!head || !prev) exit(1);
+	for(uint32_t i = 0; i < HASH_SIZE; i++) head[i] = -1;
+
+	uint32_t outPos = 0;
+	out[outPos++] = 0x11;
+	out[outPos++] = size;
+	out[outPos++] = size>>8;
+	out[outPos++] = size>>16;
+
+	uint32_t inPos = 0;
+	uint32_t flagPos = 0;
+	unsigned flagBit = 0;
+	while(inPos < size)
+	{
+		if(flagBit == 0)
+		{
+			flagPos = outPos;
+			out[outPos++] = 0;
+			flagBit = 0x80;
+		}
+
+		uint32_t bestLen = 0, bestDisp = 0;
+		if(inPos + MIN_MATCH <= size)
+		{
+			const uint32_t maxLen = (size - inPos < MAX_MATCH ? size - inPos : MAX_MATCH);
+			int32_t cand = head[hash3(&in[inPos])];
+			for(unsigned chain = 0; cand >= 0 && chain < MAX_CHAIN; chain++, cand = prev[cand])
+			{
+				const uint32_t disp = inPos - cand;
+				if(disp > WINDOW_SIZE) break;
+
+				uint32_t len = 0;
+				while(len < maxLen && in[cand + len] == in[inPos + len]) len++;
+				if(len > bestLen)
+				{
+					bestLen = len;
+					bestDisp = disp;
+					if(len == maxLen) break;
+				}
+			}
+		}
+
+		uint32_t advance;
+		if(bestLen >= MIN_MATCH)
+		{
+			const uint32_t d = bestDisp - 1;
+			out[flagPos] |= flagBit;
+			if(bestLen <= 0x10)
+			{
+				out[outPos++] = (bestLen - 1)<<4 | d>>8;
+			}
+			else if(bestLen <= 0x110)
+			{
+				const uint32_t l = bestLen - 0x11;
+				out[outPos++] = l>>4;
+				out[outPos++] = (l & 0xF)<<4 | d>>8;
+			}
+			else
+			{
+				const uint32_t l = bestLen - 0x111;
+				out[outPos++] = 0x10 | l>>12;
+				out[outPos++] = l>>4;
+				out[outPos++] = (l & 0xF)<<4 | d>>8;
+			}
+			out[outPos++] = d;
+			advance = bestLen;
+		}
+		else
+		{
+			out[outPos++] = in[inPos];
+			advance = 1;
+		}
+
+		for(; advance > 0; advance--, inPos++)
+		{
+			if(inPos + MIN_MATCH > size) continue;
+			const uint32_t h = hash3(&in[inPos]);
+			prev[inPos] = head[h];
+			head[h] = inPos;
+		}
+
+		flagBit >>= 1;
+	}
+
+	// lz11Decompress() reads byte by byte so no padding is needed
+	// but keep the size a multiple of 4 for the section.
+	while(outPos & 3) out[outPos++] = 0;
+
+	free(prev);
+	free(head);
+
+	return outPos;
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc != 3)
+	{
+		fprintf(stderr, "Usage: %s <in> <out>\n", argv[0]);
+		return 1;
+	}
+
+	uint32_t size;
+	uint8_t *in = readFile(argv[1], &size);
+	if(!in)
+	{
+		fprintf(stderr, "Failed to read %s!\n", argv[1]);
+		return 1;
+	}
+
+	// Worst case is 9 bytes for every 8 input bytes
+	uint8_t *out = malloc(4 + size + size / 8 + 8);
+	if(!out) return 1;
+	const uint32_t outSize = compress(in, size, out);
+
+	FILE *f = fopen(argv[2], "wb");
+	if(!f || fwrite(out, 1, outSize, f) != outSize)
+	{
+		fprintf(stderr, "Failed to write %s!\n", argv[2]);
+		return 1;
+	}
+	fclose(f);
+
+	printf("%s: %u -> %u bytes\n", argv[2], size, outSize);
+	free(out);
+	free(in);
+
+	return 0;
+}